@@ -0,0 +1,20 @@
+#!/bin/sh
+# --branchless の計測（[user-032]）
+#
+# 使い方: bench/branchless.sh [interpreter] [回数]
+# 既定は bin/interpreter を 5 回ずつ実行し，実時間（秒）の最小値を出す．
+# どちらも LCG で条件をおおよそ 50% の確率で変える 1 億回のループ．
+# branchless_mixed.tl は右辺の重い && || を，branchless_max.tl は最大値の更新と 2 項の && を含む．
+# ループの大域変数への書き込みが残るよう --lazy で実行する．
+# Makefile は最適化を指定しないので，数字は interpreter を -O2 で作り直して測ったもの（`make CXXFLAGS+=-O2`）．
+set -eu
+dir=$(dirname "$0")
+interpreter=${1:-bin/interpreter}
+runs=${2:-5}
+. "$dir/common.sh"
+
+for input in branchless_mixed branchless_max; do
+    printf '%-18s on %s   off %s\n' "$input" \
+        "$(best --lazy --branchless=on "$dir/$input.tl")" \
+        "$(best --lazy --branchless=off "$dir/$input.tl")"
+done
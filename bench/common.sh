@@ -0,0 +1,16 @@
+# bench/*.sh が読み込む共通の関数
+
+# best 引数...
+# "$interpreter" を "$runs" 回実行し，実時間（秒）の最小値を出す．
+best(){
+    min=
+    n=0
+    while [ "$n" -lt "$runs" ]; do
+        start=$(date +%s.%N)
+        "$interpreter" "$@" >/dev/null
+        end=$(date +%s.%N)
+        min=$(echo "$start $end ${min:-}" | awk '{ t = $2 - $1; if($3 == "" || t < $3) print t; else print $3 }')
+        n=$((n + 1))
+    done
+    printf '%.3fs' "$min"
+}
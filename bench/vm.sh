@@ -0,0 +1,19 @@
+#!/bin/sh
+# --backend=vm の計測（[user-029]）
+#
+# 使い方: bench/vm.sh [interpreter] [回数]
+# 既定は bin/interpreter を 5 回ずつ実行し，実時間（秒）の最小値を出す．
+# vm_counter.tl は 1 億回のカウンタのループ，vm_small.tl は 2 文だけのスクリプト（起動と後始末の時間）．
+# ループは JIT（--lazy で各文を実行時にコンパイル）とも比べる（JIT は O2 でループを畳むので，ほぼコンパイルの時間）．
+# Makefile は最適化を指定しないので，数字は interpreter を -O2 で作り直して測ったもの（`make CXXFLAGS+=-O2`）．
+set -eu
+dir=$(dirname "$0")
+interpreter=${1:-bin/interpreter}
+runs=${2:-5}
+. "$dir/common.sh"
+
+for input in vm_counter vm_small; do
+    printf '%-12s --backend=vm %s   --lazy %s\n' "$input" \
+        "$(best --backend=vm "$dir/$input.tl")" \
+        "$(best --lazy "$dir/$input.tl")"
+done
@@ -0,0 +1,195 @@
+/**
+ * @file bytecode.cpp
+ */
+#include "bytecode.hpp"
+
+#include <algorithm>
+#include <string_view>
+
+namespace bytecode {
+    //! コンストラクタ
+    Builder::Builder(): register_count(0), global_count(0), label_position(0) {}
+
+    //! 新しいレジスタの番号を返す．
+    std::int32_t Builder::new_register(){
+        return static_cast<std::int32_t>(register_count++);
+    }
+
+    //! 大域変数 `g[number]` を使うことを記録する．
+    void Builder::use_global(std::int32_t number){
+        if(global_count <= static_cast<std::size_t>(number)) global_count = static_cast<std::size_t>(number) + 1;
+    }
+
+    //! 命令を追加する．
+    void Builder::emit(Opcode opcode, std::int32_t a, std::int32_t b, std::int32_t c){
+        instructions.push_back({opcode, a, b, c});
+    }
+
+    /**
+     * @brief 直前に追加した命令の，実行時エラーを報告する位置を記録する．
+     *
+     * スーパー命令への融合は比較命令しか置き換えないので，記録した命令の番号は変わらない．
+     */
+    void Builder::set_position(pos::Range pos){
+        positions.emplace_back(instructions.size() - 1, std::move(pos));
+    }
+
+    /**
+     * @brief 現在の位置をジャンプの飛び先にする．
+     * @return 現在の位置（後方へのジャンプの飛び先として `emit()` に渡す）
+     */
+    std::size_t Builder::label(){
+        return label_position = instructions.size();
+    }
+
+    /**
+     * @brief 飛び先の決まっていない無条件ジャンプを追加する．
+     * @return 追加した命令の番号（`set_target()` に渡す）
+     */
+    std::size_t Builder::emit_jump(){
+        emit(Opcode::Jump);
+        return instructions.size() - 1;
+    }
+
+    /**
+     * @brief 飛び先の決まっていない「`condition` が真ならジャンプ」を追加する．
+     * @return 追加した命令の番号（`set_target()` に渡す）
+     */
+    std::size_t Builder::emit_jump_if(std::int32_t condition){
+        emit(Opcode::JumpIf, condition);
+        return instructions.size() - 1;
+    }
+
+    //! 比較命令に対応する，比較と分岐のスーパー命令
+    static bool fused_jump_unless(Opcode opcode, Opcode &fused){
+        switch(opcode){
+            case Opcode::Equal: fused = Opcode::JumpUnlessEqual; return true;
+            case Opcode::NotEqual: fused = Opcode::JumpUnlessNotEqual; return true;
+            case Opcode::Less: fused = Opcode::JumpUnlessLess; return true;
+            case Opcode::LessEqual: fused = Opcode::JumpUnlessLessEqual; return true;
+            case Opcode::Greater: fused = Opcode::JumpUnlessGreater; return true;
+            case Opcode::GreaterEqual: fused = Opcode::JumpUnlessGreaterEqual; return true;
+            default: return false;
+        }
+    }
+
+    /**
+     * @brief 飛び先の決まっていない「`condition` が偽ならジャンプ」を追加する．
+     *
+     * 直前の命令が `condition` を求める比較で，間にラベルが無ければ，比較と分岐のスーパー命令に置き換える．
+     * `condition` は比較の結果を入れるためだけの一時的なレジスタなので，比較を消しても他に影響しない．
+     * @return 追加した命令の番号（`set_target()` に渡す）
+     */
+    std::size_t Builder::emit_jump_unless(std::int32_t condition){
+        Opcode fused;
+        if(
+            !instructions.empty()
+            && label_position != instructions.size()
+            && instructions.back().a == condition
+            && fused_jump_unless(instructions.back().opcode, fused)
+        ){
+            auto &last = instructions.back();
+            last = {fused, last.b, last.c, 0};
+        }else{
+            emit(Opcode::JumpUnless, condition);
+        }
+        return instructions.size() - 1;
+    }
+
+    /**
+     * @brief `emit_jump()` 等で追加したジャンプの飛び先を現在の位置にする．
+     * @param index ジャンプ命令の番号
+     */
+    void Builder::set_target(std::size_t index){
+        auto target = static_cast<std::int32_t>(label());
+        auto &instruction = instructions[index];
+        switch(instruction.opcode){
+            case Opcode::Jump: instruction.a = target; break;
+            case Opcode::JumpIf:
+            case Opcode::JumpUnless: instruction.b = target; break;
+            default: instruction.c = target;
+        }
+    }
+
+    /**
+     * @brief 末尾に `Return` を加えて `Code` を返す．
+     */
+    Code Builder::finish(){
+        emit(Opcode::Return);
+        return Code{std::move(instructions), register_count, global_count, std::move(positions)};
+    }
+
+    /**
+     * @brief 命令 `index` を生成した式の位置を返す．
+     * @retval nullptr 位置を記録していない
+     */
+    const pos::Range *Code::position(std::size_t index) const {
+        auto found = std::lower_bound(positions.begin(), positions.end(), index, [](const auto &position, std::size_t index){
+            return position.first < index;
+        });
+        return found != positions.end() && found->first == index ? &found->second : nullptr;
+    }
+
+    /**
+     * @brief 逆アセンブルして出力する．
+     *
+     * 位置を記録した命令には，行末にその位置を付ける．
+     */
+    void Code::print(std::ostream &os) const {
+        for(std::size_t i = 0; i < instructions.size(); ++i){
+            auto &[opcode, a, b, c] = instructions[i];
+            std::string_view name;
+            // オペランドの形式: r = レジスタ，g = 大域変数，i = 即値，l = 命令の番号
+            std::string_view format;
+            switch(opcode){
+                case Opcode::Constant: name = "constant"; format = "ri"; break;
+                case Opcode::Move: name = "move"; format = "rr"; break;
+                case Opcode::LoadGlobal: name = "load_global"; format = "rg"; break;
+                case Opcode::StoreGlobal: name = "store_global"; format = "gr"; break;
+                case Opcode::Add: name = "add"; format = "rrr"; break;
+                case Opcode::Sub: name = "sub"; format = "rrr"; break;
+                case Opcode::Mul: name = "mul"; format = "rrr"; break;
+                case Opcode::Div: name = "div"; format = "rrr"; break;
+                case Opcode::Rem: name = "rem"; format = "rrr"; break;
+                case Opcode::LeftShift: name = "left_shift"; format = "rrr"; break;
+                case Opcode::RightShift: name = "right_shift"; format = "rrr"; break;
+                case Opcode::BitAnd: name = "bit_and"; format = "rrr"; break;
+                case Opcode::BitOr: name = "bit_or"; format = "rrr"; break;
+                case Opcode::BitXor: name = "bit_xor"; format = "rrr"; break;
+                case Opcode::Minus: name = "minus"; format = "rr"; break;
+                case Opcode::BitNot: name = "bit_not"; format = "rr"; break;
+                case Opcode::LogicalNot: name = "logical_not"; format = "rr"; break;
+                case Opcode::Equal: name = "equal"; format = "rrr"; break;
+                case Opcode::NotEqual: name = "not_equal"; format = "rrr"; break;
+                case Opcode::Less: name = "less"; format = "rrr"; break;
+                case Opcode::LessEqual: name = "less_equal"; format = "rrr"; break;
+                case Opcode::Greater: name = "greater"; format = "rrr"; break;
+                case Opcode::GreaterEqual: name = "greater_equal"; format = "rrr"; break;
+                case Opcode::Jump: name = "jump"; format = "l"; break;
+                case Opcode::JumpIf: name = "jump_if"; format = "rl"; break;
+                case Opcode::JumpUnless: name = "jump_unless"; format = "rl"; break;
+                case Opcode::JumpUnlessEqual: name = "jump_unless_equal"; format = "rrl"; break;
+                case Opcode::JumpUnlessNotEqual: name = "jump_unless_not_equal"; format = "rrl"; break;
+                case Opcode::JumpUnlessLess: name = "jump_unless_less"; format = "rrl"; break;
+                case Opcode::JumpUnlessLessEqual: name = "jump_unless_less_equal"; format = "rrl"; break;
+                case Opcode::JumpUnlessGreater: name = "jump_unless_greater"; format = "rrl"; break;
+                case Opcode::JumpUnlessGreaterEqual: name = "jump_unless_greater_equal"; format = "rrl"; break;
+                case Opcode::AddGlobal: name = "add_global"; format = "rgr"; break;
+                case Opcode::Return: name = "return"; format = ""; break;
+            }
+            os << i << ": " << name;
+            std::int32_t operands[] = {a, b, c};
+            for(std::size_t j = 0; j < format.size(); ++j){
+                os << (j ? ", " : " ");
+                switch(format[j]){
+                    case 'r': os << "r" << operands[j]; break;
+                    case 'g': os << "g" << operands[j]; break;
+                    case 'l': os << "@" << operands[j]; break;
+                    default: os << operands[j];
+                }
+            }
+            if(auto pos = position(i)) os << " ; " << *pos;
+            os << std::endl;
+        }
+    }
+}
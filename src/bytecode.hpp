@@ -0,0 +1,199 @@
+/**
+ * @file bytecode.hpp
+ * @brief LLVM を使わずに実行するためのレジスタ型バイトコード
+ */
+#ifndef BYTECODE_HPP
+#define BYTECODE_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <limits>
+#include <optional>
+#include <utility>
+#include <vector>
+
+#include "error.hpp"
+
+/**
+ * @brief LLVM を使わずに実行するためのレジスタ型バイトコード．
+ *
+ * 整数は i32（2 の補数で wrap-around），真偽値は 0 か 1 を i32 のレジスタに入れて表す．
+ * 大域変数 `g[N]` の番号は `Context::global_variable_name()` の番号と同じ．
+ * このヘッダと `vm.hpp` は LLVM に依存しない．
+ */
+namespace bytecode {
+    /**
+     * @brief 命令の種類．
+     *
+     * 各命令のオペランドは `Instruction::a`，`b`，`c`．
+     * 以下 `r[i]` はレジスタ，`g[i]` は大域変数，`pc` は次に実行する命令の番号を表す．
+     */
+    enum class Opcode : std::uint8_t {
+        //! `r[a] = b`
+        Constant,
+        //! `r[a] = r[b]`
+        Move,
+        //! `r[a] = g[b]`
+        LoadGlobal,
+        //! `g[a] = r[b]`
+        StoreGlobal,
+        //! `r[a] = r[b] + r[c]`（i32）
+        Add,
+        //! `r[a] = r[b] - r[c]`（i32）
+        Sub,
+        //! `r[a] = r[b] * r[c]`（i32）
+        Mul,
+        //! `r[a] = r[b] / r[c]`（i32，0 除算は `error::DivisionByZero`，`INT_MIN / -1` は `INT_MIN`）
+        Div,
+        //! `r[a] = r[b] % r[c]`（i32，0 除算は `error::DivisionByZero`，`INT_MIN % -1` は 0）
+        Rem,
+        //! `r[a] = r[b] << r[c]`（i32）
+        LeftShift,
+        //! `r[a] = r[b] >> r[c]`（i32，算術シフト）
+        RightShift,
+        //! `r[a] = r[b] & r[c]`（i32，i1）
+        BitAnd,
+        //! `r[a] = r[b] | r[c]`（i32，i1）
+        BitOr,
+        //! `r[a] = r[b] ^ r[c]`（i32，i1）
+        BitXor,
+        //! `r[a] = -r[b]`（i32）
+        Minus,
+        //! `r[a] = ~r[b]`（i32）
+        BitNot,
+        //! `r[a] = !r[b]`（i1）
+        LogicalNot,
+        //! `r[a] = r[b] == r[c]`（i32，i1）
+        Equal,
+        //! `r[a] = r[b] != r[c]`（i32，i1）
+        NotEqual,
+        //! `r[a] = r[b] < r[c]`（i32）
+        Less,
+        //! `r[a] = r[b] <= r[c]`（i32）
+        LessEqual,
+        //! `r[a] = r[b] > r[c]`（i32）
+        Greater,
+        //! `r[a] = r[b] >= r[c]`（i32）
+        GreaterEqual,
+        //! `pc = a`
+        Jump,
+        //! `if(r[a]) pc = b`
+        JumpIf,
+        //! `if(!r[a]) pc = b`
+        JumpUnless,
+        //! `if(!(r[a] == r[b])) pc = c`（比較と分岐のスーパー命令）
+        JumpUnlessEqual,
+        //! `if(!(r[a] != r[b])) pc = c`（比較と分岐のスーパー命令）
+        JumpUnlessNotEqual,
+        //! `if(!(r[a] < r[b])) pc = c`（比較と分岐のスーパー命令）
+        JumpUnlessLess,
+        //! `if(!(r[a] <= r[b])) pc = c`（比較と分岐のスーパー命令）
+        JumpUnlessLessEqual,
+        //! `if(!(r[a] > r[b])) pc = c`（比較と分岐のスーパー命令）
+        JumpUnlessGreater,
+        //! `if(!(r[a] >= r[b])) pc = c`（比較と分岐のスーパー命令）
+        JumpUnlessGreaterEqual,
+        //! `r[a] = g[b] += r[c]`（読み込み・加算・書き込みのスーパー命令）
+        AddGlobal,
+        //! 実行を終える
+        Return
+    };
+
+    /**
+     * @brief 2 オペランドの算術・論理・比較命令の意味を定める．
+     *
+     * `VM` と，AST を直接評価する `expression::Expression::evaluate()` が共有する．
+     * 加減乗算と `INT_MIN / -1` は 2 の補数で折り返す（`INT_MIN / -1 == INT_MIN`，`INT_MIN % -1 == 0`）．
+     * 0 による除算・剰余は実行時エラーにする．どちらもホストの C++ では未定義なので，計算する前に調べる．
+     * @param opcode `Add` から `GreaterEqual` まで（単項の `Minus` `BitNot` `LogicalNot` は `left` のみ使う）
+     * @param pos エラーを報告する式の位置（`nullptr` なら位置無しで報告する）
+     * @throw error::DivisionByZero `Div` `Rem` で `right` が 0
+     */
+    inline std::int32_t apply(Opcode opcode, std::int32_t left, std::int32_t right, const pos::Range *pos = nullptr){
+        auto wrap = [](std::uint32_t value){ return static_cast<std::int32_t>(value); };
+        auto unsign = [](std::int32_t value){ return static_cast<std::uint32_t>(value); };
+        switch(opcode){
+            case Opcode::Add: return wrap(unsign(left) + unsign(right));
+            case Opcode::Sub: return wrap(unsign(left) - unsign(right));
+            case Opcode::Mul: return wrap(unsign(left) * unsign(right));
+            case Opcode::Div:
+            case Opcode::Rem:
+                if(right == 0){
+                    throw error::make<error::DivisionByZero>(pos ? std::optional<pos::Range>(pos->clone()) : std::nullopt);
+                }
+                if(left == std::numeric_limits<std::int32_t>::min() && right == -1) return opcode == Opcode::Div ? left : 0;
+                return opcode == Opcode::Div ? left / right : left % right;
+            case Opcode::LeftShift: return wrap(unsign(left) << (right & 31));
+            case Opcode::RightShift: return left >> (right & 31);
+            case Opcode::BitAnd: return left & right;
+            case Opcode::BitOr: return left | right;
+            case Opcode::BitXor: return left ^ right;
+            case Opcode::Minus: return wrap(0u - unsign(left));
+            case Opcode::BitNot: return ~left;
+            case Opcode::LogicalNot: return !left;
+            case Opcode::Equal: return left == right;
+            case Opcode::NotEqual: return left != right;
+            case Opcode::Less: return left < right;
+            case Opcode::LessEqual: return left <= right;
+            case Opcode::Greater: return left > right;
+            case Opcode::GreaterEqual: return left >= right;
+            default: return 0;
+        }
+    }
+
+    /**
+     * @brief 1 つの命令
+     */
+    struct Instruction {
+        Opcode opcode;
+        std::int32_t a, b, c;
+    };
+
+    /**
+     * @brief 実行できる命令列
+     */
+    struct Code {
+        std::vector<Instruction> instructions;
+        //! 使うレジスタの数
+        std::size_t register_count;
+        //! 使う大域変数の番号の最大値 + 1
+        std::size_t global_count;
+        /**
+         * @brief 実行時エラーになりうる命令の番号と，その命令を生成した式の位置（命令の番号の昇順）
+         *
+         * 0 で割るかもしれない `Div` `Rem` だけが持つ（`Builder::set_position()`）．
+         */
+        std::vector<std::pair<std::size_t, pos::Range>> positions;
+        const pos::Range *position(std::size_t) const;
+        void print(std::ostream &) const;
+    };
+
+    /**
+     * @brief `Code` を組み立てるクラス．
+     *
+     * 前方へのジャンプは `emit_jump()` などが返す命令の番号を後から `set_target()` に渡して飛び先を埋める．
+     * 後方へのジャンプは先に `label()` で飛び先を得ておく．
+     */
+    class Builder {
+        std::vector<Instruction> instructions;
+        std::size_t register_count, global_count;
+        //! 最後にラベルが置かれた位置（その直前の命令とはスーパー命令に融合できない）
+        std::size_t label_position;
+        std::vector<std::pair<std::size_t, pos::Range>> positions;
+    public:
+        Builder();
+        std::int32_t new_register();
+        void use_global(std::int32_t);
+        void emit(Opcode, std::int32_t = 0, std::int32_t = 0, std::int32_t = 0);
+        void set_position(pos::Range);
+        std::size_t label();
+        std::size_t emit_jump();
+        std::size_t emit_jump_if(std::int32_t);
+        std::size_t emit_jump_unless(std::int32_t);
+        void set_target(std::size_t);
+        Code finish();
+    };
+}
+
+#endif
@@ -2,14 +2,58 @@
  * @file context.cpp
  */
 #include "context.hpp"
+#include "expression.hpp"
+#include "runtime.hpp"
 
+#include <algorithm>
+#include <limits>
 #include <sstream>
 
+#include "llvm/IR/MDBuilder.h"
+
 //! コンストラクタ
 Context::Context():
     context(std::make_unique<llvm::LLVMContext>()),
-    builder(*context.getContext()),
-    current_module_number(0) {}
+    builder(std::make_unique<llvm::IRBuilder<llvm::ConstantFolder, llvm::IRBuilderDefaultInserter>>(*context.getContext())),
+    current_module_number(0),
+    linkage(llvm::GlobalValue::ExternalLinkage),
+    branchless(true),
+    context_lifetime(0),
+    loop_preheader(nullptr),
+    counters(nullptr),
+    source_names(false),
+    debug_info(false),
+    source(nullptr),
+    pgo_instrumentation(nullptr),
+    pgo_profile(nullptr),
+    remarks(nullptr),
+    available_block(nullptr),
+    modules_in_context(0),
+    source_line(0),
+    compile_unit(nullptr),
+    subprogram(nullptr),
+    sentence_hash(0),
+    next_site(0) {}
+
+/**
+ * @brief `context` を新しい `llvm::LLVMContext` に取り替え，`builder` を作り直す．
+ *
+ * 古い `context` の値を指すものは先に捨てる．
+ * 古い `context` は，それで作ったモジュールを持つ `llvm::orc::ThreadSafeModule` がすべて無くなれば解放される．
+ */
+void Context::renew_context(){
+    ssa.clear();
+    available_expressions.clear();
+    speculated_loads.clear();
+    debug_builder.reset();
+    compile_unit = nullptr;
+    subprogram = nullptr;
+    module.reset();
+    builder.reset();
+    context = llvm::orc::ThreadSafeContext(std::make_unique<llvm::LLVMContext>());
+    builder = std::make_unique<llvm::IRBuilder<llvm::ConstantFolder, llvm::IRBuilderDefaultInserter>>(*context.getContext());
+    modules_in_context = 0;
+}
 
 static std::string module_name(unsigned module_number){
     std::stringstream ret;
@@ -17,21 +61,169 @@ static std::string module_name(unsigned module_number){
     return ret.str();
 }
 
+/**
+ * @brief 文 1 つ分の新しいモジュールを作る．
+ *
+ * `context_lifetime` 個のモジュールを作ったら，先に `context` を取り替える．
+ */
 llvm::Module &Context::next_module(){
+    if(context_lifetime && modules_in_context >= context_lifetime) renew_context();
+    modules_in_context++;
     current_module_number++;
+    source_line = 0;
+    speculated_loads.clear();
+    written_globals.clear();
+    available_expressions.clear();
+    available_block = nullptr;
+    read_variables.clear();
     module = std::make_unique<llvm::Module>(module_name(current_module_number), *context.getContext());
+    start_debug_info();
+    if(remarks) remarks->attach(*context.getContext());
     return *module;
 }
 
+/**
+ * @brief プログラム全体を収める単一のモジュール `m0` を作る．
+ *
+ * 以降の文は `next_sentence()` で番号だけを進め，すべてこのモジュールにコンパイルする．
+ * 大域変数は外から参照されないので `InternalLinkage` にする．
+ */
+llvm::Module &Context::program_module(){
+    linkage = llvm::GlobalValue::InternalLinkage;
+    speculated_loads.clear();
+    written_globals.clear();
+    available_expressions.clear();
+    available_block = nullptr;
+    read_variables.clear();
+    module = std::make_unique<llvm::Module>(module_name(0), *context.getContext());
+    start_debug_info();
+    if(remarks) remarks->attach(*context.getContext());
+    return *module;
+}
+
+/**
+ * @brief モジュールを作らずに文の番号だけを進める．
+ */
+void Context::next_sentence(){
+    current_module_number++;
+}
+
+/**
+ * @brief コンパイルする文の位置を設定する．
+ *
+ * `source_names` なら，以降の `function_name()` は文が始まる行を含む．
+ * `source` があれば文の本文のハッシュを求め，文の中の分岐の番号を 0 から数え直す（`pgo::Site`）．
+ */
+void Context::set_source(const pos::Range &range){
+    source_line = range.get_start().into_inner().first + 1;
+    sentence_hash = source ? pgo::hash(range.text(*source)) : 0;
+    next_site = 0;
+}
+
+/**
+ * @brief `debug_info` なら，新しいモジュールにコンパイル単位を作る．
+ *
+ * モジュールを `llvm::Linker` で結合すると，コンパイル単位はそれぞれ残る．
+ * 前のモジュールの位置が残っていると別のモジュールの `DISubprogram` を指してしまうので，ここで消す．
+ */
+void Context::start_debug_info(){
+    subprogram = nullptr;
+    builder->SetCurrentDebugLocation(llvm::DebugLoc());
+    if(!debug_info) return;
+    debug_builder = std::make_unique<llvm::DIBuilder>(*module);
+    auto file = debug_builder->createFile(source_file, ".");
+    compile_unit = debug_builder->createCompileUnit(llvm::dwarf::DW_LANG_C, file, "interpreter", true, "", 0);
+    module->addModuleFlag(llvm::Module::Warning, "Debug Info Version", llvm::DEBUG_METADATA_VERSION);
+    module->addModuleFlag(llvm::Module::Warning, "Dwarf Version", 4);
+}
+
+/**
+ * @brief `debug_info` なら，今のモジュールに定義した関数 `function` の `DISubprogram` を作る．
+ *
+ * 以降の命令の位置は `function` の中になり，まず `range` の開始位置にする．
+ */
+void Context::start_function(llvm::Function *function, const pos::Range &range){
+    if(!debug_builder) return;
+    auto [line, column] = range.get_start().into_inner();
+    auto file = compile_unit->getFile();
+    auto type = debug_builder->createSubroutineType(debug_builder->getOrCreateTypeArray({nullptr}));
+    subprogram = debug_builder->createFunction(
+        file,
+        function->getName(),
+        function->getName(),
+        file,
+        line + 1,
+        type,
+        line + 1,
+        llvm::DINode::FlagZero,
+        llvm::DISubprogram::SPFlagDefinition | llvm::DISubprogram::SPFlagOptimized
+    );
+    function->setSubprogram(subprogram);
+    set_location(range);
+}
+
+/**
+ * @brief 以降に生成する命令の位置を `range` の開始位置にする．
+ *
+ * `debug_info` でなければ何もしない．
+ * `remarks` があれば，リマークの位置を戻せるよう `range` を記録する．
+ */
+void Context::set_location(const pos::Range &range){
+    if(remarks) remarks->add_range(range);
+    if(!subprogram) return;
+    auto [line, column] = range.get_start().into_inner();
+    builder->SetCurrentDebugLocation(llvm::DILocation::get(*context.getContext(), line + 1, column + 1, subprogram));
+}
+
+/**
+ * @brief `debug_info` なら，宣言 `range` で定義した大域変数 `variable` の `DIGlobalVariable` を作る．
+ * @param name ソースコード中の変数名
+ */
+void Context::describe_global(llvm::GlobalVariable *variable, const std::string &name, value::Type &type, const pos::Range &range){
+    if(!debug_builder) return;
+    auto line = range.get_start().into_inner().first + 1;
+    auto file = compile_unit->getFile();
+    auto debug_type = type.is_boolean()
+        ? debug_builder->createBasicType("boolean", 8, llvm::dwarf::DW_ATE_boolean)
+        : debug_builder->createBasicType("integer", 32, llvm::dwarf::DW_ATE_signed);
+    variable->addDebugInfo(debug_builder->createGlobalVariableExpression(
+        compile_unit, name, variable->getName(), file, line, debug_type, variable->hasLocalLinkage()
+    ));
+}
+
 llvm::Module &Context::get_module(){ return *module; }
-std::unique_ptr<llvm::Module> Context::take_module(){ return std::move(module); }
+/**
+ * @brief コンパイルし終えたモジュールを取り出す．
+ *
+ * 取り出す前に，定数と仮定した大域変数の `load` を確定し（`resolve_speculated_loads()`），
+ * デバッグ情報を完成させる．
+ */
+std::unique_ptr<llvm::Module> Context::take_module(){
+    resolve_speculated_loads();
+    if(debug_builder){
+        debug_builder->finalize();
+        debug_builder.reset();
+        compile_unit = nullptr;
+    }
+    subprogram = nullptr;
+    builder->SetCurrentDebugLocation(llvm::DebugLoc());
+    return std::move(module);
+}
 
 unsigned Context::get_module_number(){
     return current_module_number;
 }
 
+/**
+ * @brief 今のモジュールの関数名 `f<N>`
+ *
+ * `source_names` で `set_source()` していれば，文が始まる行 `L` を付けて `f<N>.line<L>` にする．
+ */
 std::string Context::function_name(){
-    return function_name(current_module_number);
+    if(!source_names || !source_line) return function_name(current_module_number);
+    std::stringstream ret;
+    ret << "f" << current_module_number << ".line" << source_line;
+    return ret.str();
 }
 std::string Context::function_name(unsigned module_number){
     std::stringstream ret;
@@ -47,3 +239,320 @@ std::string Context::global_variable_name(unsigned module_number){
     ret << "g" << module_number;
     return ret.str();
 }
+
+/**
+ * @brief 番号 `module_number` の大域変数を現在のモジュールから得る．
+ *
+ * 現在のモジュールで定義済み（プログラム全体を 1 つのモジュールにしている場合など）ならそれを返し，
+ * そうでなければ外部の大域変数として宣言する．
+ */
+llvm::GlobalVariable *Context::global_variable(unsigned module_number, llvm::Type *llvm_type){
+    auto name = global_variable_name(module_number);
+    if(auto variable = module->getNamedGlobal(name)) return variable;
+    return new llvm::GlobalVariable(
+        *module,
+        llvm_type,
+        false,
+        llvm::GlobalValue::ExternalLinkage,
+        nullptr,
+        name
+    );
+}
+
+/**
+ * @brief 大域変数 `g<N>` への読み書きに付ける TBAA のアクセスタグ．
+ *
+ * 型ごとのノード（`integer` / `boolean`）の下に大域変数ごとのノードを置く．
+ * 兄弟のノードどうしは別名にならないので，異なる `g<N>` や異なる型への読み書きは互いに干渉しないと分かる．
+ * ノードは名前で一意化されるので，別々のモジュールで作っても同じものになる．
+ */
+llvm::MDNode *Context::global_tbaa(unsigned module_number, value::Type &type){
+    llvm::MDBuilder md_builder(*context.getContext());
+    auto root = md_builder.createTBAARoot("interpreter TBAA");
+    auto type_node = md_builder.createTBAAScalarTypeNode(type.is_boolean() ? "boolean" : "integer", root);
+    auto variable_node = md_builder.createTBAAScalarTypeNode(global_variable_name(module_number), type_node);
+    return md_builder.createTBAAStructTagNode(variable_node, variable_node, 0);
+}
+
+/**
+ * @brief `counters` があれば，`range` の位置のカウンタを確保し，現在の位置でそれを `amount` 増やす．
+ *
+ * カウンタのアドレスは定数として埋め込む．読み書きには大域変数とは別の TBAA の型 `counter` を付けるので，
+ * ループの中のカウンタは最適化でレジスタに昇格され，ループの後で一度だけ書き込まれる．
+ * @param amount 増やす値（`i64`）．`nullptr` なら 1
+ */
+void Context::count(pos::Range range, llvm::Value *amount){
+    if(!counters) return;
+    increment(counters->add(std::move(range)), amount);
+}
+
+/**
+ * @brief 現在の位置で，アドレス `address` の 64 ビットのカウンタを `amount` 増やす（`count()` を参照）．
+ * @param amount 増やす値（`i64`）．`nullptr` なら 1
+ */
+void Context::increment(std::uint64_t *address, llvm::Value *amount){
+    auto int64_type = builder->getInt64Ty();
+    auto pointer = llvm::ConstantExpr::getIntToPtr(
+        builder->getInt64(reinterpret_cast<std::uintptr_t>(address)),
+        int64_type->getPointerTo()
+    );
+    llvm::MDBuilder md_builder(*context.getContext());
+    auto counter_node = md_builder.createTBAAScalarTypeNode("counter", md_builder.createTBAARoot("interpreter TBAA"));
+    auto tbaa = md_builder.createTBAAStructTagNode(counter_node, counter_node, 0);
+    auto load = builder->CreateLoad(int64_type, pointer);
+    load->setMetadata(llvm::LLVMContext::MD_tbaa, tbaa);
+    auto store = builder->CreateStore(builder->CreateAdd(load, amount ? amount : builder->getInt64(1)), pointer);
+    store->setMetadata(llvm::LLVMContext::MD_tbaa, tbaa);
+}
+
+/**
+ * @brief 今の文の入口（`pgo::Site` の 0 番）をプロファイルする．
+ *
+ * `pgo_instrumentation` があれば，現在の位置で文の実行回数を数える．
+ * `pgo_profile` があれば，その回数を `function` の実行回数にし，モジュールにプロファイルの要約を付ける．
+ * プログラム全体を 1 つの関数にするときは，最初に回数が見つかった文の回数を使う．
+ */
+void Context::profile_entry(llvm::Function *function){
+    pgo::Site site{sentence_hash, next_site++};
+    if(pgo_instrumentation) increment(&pgo_instrumentation->add(site)->reached, nullptr);
+    if(!pgo_profile) return;
+    if(!module->getProfileSummary(false)){
+        if(auto summary = pgo_profile->summary_metadata(*context.getContext())){
+            module->setProfileSummary(summary, llvm::ProfileSummary::PSK_Instr);
+        }
+    }
+    if(function->getEntryCount()) return;
+    if(auto counts = pgo_profile->find(site)) function->setEntryCount(counts->reached);
+}
+
+/**
+ * @brief 条件 `condition` で分岐する箇所をプロファイルする．
+ *
+ * 文の中の次の番号を割り当てる．分岐せずに `select` などにする場合も，番号がずれないように呼ぶ．
+ * `pgo_instrumentation` があれば，現在の位置で到達した回数と `condition` が真だった回数を数える．
+ * @return `pgo_profile` にこの分岐の回数があれば，真の側と偽の側の重みの `!prof`．無ければ `nullptr`
+ */
+llvm::MDNode *Context::profile_branch(llvm::Value *condition){
+    pgo::Site site{sentence_hash, next_site++};
+    if(pgo_instrumentation){
+        auto counts = pgo_instrumentation->add(site);
+        increment(&counts->reached, nullptr);
+        increment(&counts->taken, builder->CreateZExt(condition, builder->getInt64Ty()));
+    }
+    if(!pgo_profile) return nullptr;
+    auto counts = pgo_profile->find(site);
+    if(!counts || !counts->reached) return nullptr;
+    std::uint64_t scale = counts->reached / std::numeric_limits<std::uint32_t>::max() + 1;
+    llvm::MDBuilder md_builder(*context.getContext());
+    return md_builder.createBranchWeights(
+        static_cast<std::uint32_t>(counts->taken / scale),
+        static_cast<std::uint32_t>((counts->reached - counts->taken) / scale)
+    );
+}
+
+/**
+ * @brief 現在の位置で大域変数 `g<N>` を読む．
+ *
+ * 現在のモジュールに無ければ宣言し（`global_variable()`），TBAA のタグ（`global_tbaa()`）を付ける．
+ */
+llvm::Value *Context::load_global(unsigned module_number, value::Type &type){
+    auto llvm_type = type.llvm_type(*context.getContext());
+    auto load = builder->CreateLoad(llvm_type, global_variable(module_number, llvm_type));
+    load->setMetadata(llvm::LLVMContext::MD_tbaa, global_tbaa(module_number, type));
+    return load;
+}
+
+//! 現在の位置で大域変数 `g<N>` に書き込む．`load_global()` を参照．
+void Context::store_global(unsigned module_number, value::Type &type, llvm::Value *value){
+    auto store = builder->CreateStore(value, global_variable(module_number, type.llvm_type(*context.getContext())));
+    store->setMetadata(llvm::LLVMContext::MD_tbaa, global_tbaa(module_number, type));
+}
+
+/**
+ * @brief 名前から引いた大域変数を現在の位置で読む．
+ *
+ * 宣言の初期値が定数で，宣言より後にまだ一度も代入されていない大域変数は，その値のままだと仮定する．
+ * 読む位置ではひとまず `load` を作っておき，モジュールをコンパイルし終えたときに
+ * （同じモジュールの後ろのほうで代入されていなければ）定数に置き換える（`resolve_speculated_loads()`）．
+ */
+llvm::Value *Context::load_global(DeclaredGlobal &global){
+    auto value = load_global(global.number, *global.type);
+    if(global.initial_value && global.writes == 0){
+        speculated_loads.emplace_back(llvm::cast<llvm::LoadInst>(value), global.number, global.initial_value.value());
+    }
+    return value;
+}
+
+/**
+ * @brief 名前から引いた大域変数に現在の位置で書き込む．
+ *
+ * 代入された回数を数え，以降の文ではこの大域変数を定数と仮定しないようにする．
+ */
+void Context::store_global(DeclaredGlobal &global, llvm::Value *value){
+    global.writes++;
+    written_globals.insert(global.number);
+    store_global(global.number, *global.type, value);
+}
+
+/**
+ * @brief 定数と仮定して読んだ大域変数の `load` を，仮定が成り立つものだけ定数に置き換える．
+ *
+ * 文は書かれた順にちょうど 1 回ずつ実行されるので，後の文での代入は既にコンパイルした文の実行結果に影響しない．
+ * 仮定が崩れうるのは同じモジュールの中で代入されている場合（ループの後半での代入など）だけなので，
+ * その大域変数の `load` はそのまま残す．
+ */
+void Context::resolve_speculated_loads(){
+    for(auto &[load, number, value] : speculated_loads){
+        if(written_globals.count(number)) continue;
+        load->replaceAllUsesWith(llvm::ConstantInt::get(load->getType(), value, true));
+        load->eraseFromParent();
+    }
+    speculated_loads.clear();
+    written_globals.clear();
+}
+
+/**
+ * @brief `expression` と同じ構造の式を現在の基本ブロックで計算済みなら，その値を返す．
+ *
+ * 構造の番号はハッシュなので，番号が同じなら構造も同じか確かめる（`expression::Expression::same_structure()`）．
+ * 確かめるのは使い回す部分木だけで，その中はもうコンパイルしないので，かかる時間は式の大きさに比例する．
+ * 使い回した式が読む変数も `read_variables` に加え，外側の式が正しく無効化されるようにする．
+ * @retval std::nullopt 計算済みでない
+ */
+std::optional<value::Value> Context::find_available(const expression::Expression &expression){
+    if(builder->GetInsertBlock() != available_block) return std::nullopt;
+    auto available = available_expressions.find(expression.structure);
+    if(available == available_expressions.end() || !available->second.llvm_value) return std::nullopt;
+    if(!expression.same_structure(*available->second.expression)) return std::nullopt;
+    auto &reads = available->second.reads;
+    read_variables.insert(read_variables.end(), reads.begin(), reads.end());
+    return value::Value(available->second.type, available->second.llvm_value);
+}
+
+/**
+ * @brief 式 `expression` を現在の基本ブロックで計算したことを記録する．
+ *
+ * 記録は `expression` を指すので，次のモジュールを作るまで `expression` を破棄してはならない．
+ * @param first_read 式をコンパイルする前の `read_variables` の長さ
+ */
+void Context::make_available(const expression::Expression &expression, const value::Value &value, std::size_t first_read){
+    if(builder->GetInsertBlock() != available_block){
+        available_expressions.clear();
+        available_block = builder->GetInsertBlock();
+    }
+    std::vector<std::string> reads(read_variables.begin() + first_read, read_variables.end());
+    available_expressions.insert_or_assign(expression.structure, AvailableExpression{&expression, value.type, value.llvm_value, std::move(reads)});
+}
+
+//! 変数 `name` に代入したか，`name` の指す変数が変わった（宣言やブロックの終わり）ので，`name` を読む式を捨てる．
+void Context::invalidate_available(const std::string &name){
+    for(auto it = available_expressions.begin(); it != available_expressions.end();){
+        auto &reads = it->second.reads;
+        if(std::find(reads.begin(), reads.end(), name) != reads.end()) it = available_expressions.erase(it);
+        else ++it;
+    }
+}
+
+/**
+ * @brief 宣言の番号 `index`（`Binding::index`）の大域変数を登録する．
+ */
+DeclaredGlobal &Context::define_global(unsigned index, DeclaredGlobal global){
+    if(globals.size() <= index) globals.resize(index + 1);
+    return globals[index] = std::move(global);
+}
+
+//! 宣言の番号 `index` の大域変数が宣言し直されて隠れたことを記録する（`retired_globals`）．
+void Context::retire_global(unsigned index){
+    retired_globals.push_back(globals[index].number);
+}
+
+/**
+ * @brief ループの中で初めて参照された大域変数を `ssa::Builder` の変数に昇格する．
+ *
+ * 最も外側のループの直前（`loop_preheader` の終端命令の前）で一度だけ読み込み，
+ * ループの中ではその変数として読み書きする．この言語ではポインタも関数呼び出しも無いので，
+ * ループの中の大域変数への読み書きはすべて名前による直接のものであり，いつでも昇格できる．
+ * @return `ssa::Builder` の変数の番号
+ */
+unsigned Context::promote_global(DeclaredGlobal &global){
+    llvm::Value *value;
+    {
+        llvm::IRBuilderBase::InsertPointGuard guard(*builder);
+        builder->SetInsertPoint(loop_preheader->getTerminator());
+        value = load_global(global);
+    }
+    auto variable = ssa.new_variable(global.type->llvm_type(*context.getContext()), global_variable_name(global.number));
+    ssa.write(variable, loop_preheader, value);
+    global.promoted = variable;
+    global.promoted_written = false;
+    promoted_globals.push_back(&global);
+    return variable;
+}
+
+/**
+ * @brief 最も外側のループを出たところで，昇格した大域変数のうち書き込まれたものを書き戻す．
+ *
+ * ループの中で実行時エラーを報告する位置（`loop_reports`）でも，報告する直前に書き戻す．
+ * 現在の位置はループの出口の基本ブロックでなければならない．
+ */
+void Context::write_back_promoted_globals(){
+    for(auto report : loop_reports){
+        llvm::IRBuilderBase::InsertPointGuard guard(*builder);
+        builder->SetInsertPoint(report);
+        for(auto global : promoted_globals){
+            if(global->promoted_written) store_global(global->number, *global->type, ssa.read(global->promoted.value(), report->getParent()));
+        }
+    }
+    loop_reports.clear();
+    for(auto global : promoted_globals){
+        auto variable = global->promoted.value();
+        global->promoted = std::nullopt;
+        if(global->promoted_written) store_global(*global, ssa.read(variable, builder->GetInsertBlock()));
+    }
+    promoted_globals.clear();
+    loop_preheader = nullptr;
+}
+
+/**
+ * @brief 現在の位置で，`divisor` が 0 なら 0 による除算を報告して文の実行を打ち切る分岐を作る．
+ *
+ * 報告する基本ブロック `div.zero` は `runtime::DIVISION_BY_ZERO` を呼ぶ．
+ * ループの中なら，途中で打ち切っても書き込んだ値が残るよう，昇格した大域変数を呼ぶ前に書き戻す．
+ * どれを書き戻すかはループをコンパイルし終えるまで分からないので，`write_back_promoted_globals()` で書き込む．
+ * 以降の命令は `div.ok` に置く．`div.ok` は元の基本ブロックだけから来るので，計算済みの式はそのまま使える．
+ * @param pos 報告する式の位置
+ */
+void Context::check_divisor(llvm::Value *divisor, const pos::Range &pos){
+    auto &llvm_context = *context.getContext();
+    auto block = builder->GetInsertBlock();
+    auto function = block->getParent();
+    auto error_block = llvm::BasicBlock::Create(llvm_context, "div.zero", function);
+    auto continue_block = llvm::BasicBlock::Create(llvm_context, "div.ok", function);
+    llvm::MDBuilder md_builder(llvm_context);
+    builder->CreateCondBr(builder->CreateICmpEQ(divisor, builder->getInt32(0)), error_block, continue_block, md_builder.createBranchWeights(1, 2000));
+    ssa.seal(error_block);
+    ssa.seal(continue_block);
+    builder->SetInsertPoint(error_block);
+    auto report = module->getFunction(runtime::DIVISION_BY_ZERO);
+    if(!report){
+        auto int64_type = builder->getInt64Ty();
+        report = llvm::Function::Create(
+            llvm::FunctionType::get(builder->getVoidTy(), {int64_type, int64_type, int64_type, int64_type}, false),
+            llvm::Function::ExternalLinkage,
+            runtime::DIVISION_BY_ZERO,
+            *module
+        );
+        report->setDoesNotReturn();
+        report->setDoesNotThrow();
+        report->addFnAttr(llvm::Attribute::Cold);
+    }
+    auto [start_line, start_byte] = pos.get_start().into_inner();
+    auto [end_line, end_byte] = pos.get_end().into_inner();
+    auto call = builder->CreateCall(report, {
+        builder->getInt64(start_line), builder->getInt64(start_byte), builder->getInt64(end_line), builder->getInt64(end_byte)
+    });
+    if(loop_preheader) loop_reports.push_back(call);
+    builder->CreateUnreachable();
+    builder->SetInsertPoint(continue_block);
+    if(available_block == block) available_block = continue_block;
+}
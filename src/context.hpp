@@ -4,31 +4,217 @@
 #ifndef CONTEXT_HPP
 #define CONTEXT_HPP
 
+#include <cstdint>
+#include <deque>
+#include <optional>
 #include <unordered_map>
+#include <unordered_set>
 #include <string>
+#include <tuple>
 #include <utility>
+#include <vector>
 
+#include "counters.hpp"
+#include "pgo.hpp"
+#include "remarks.hpp"
+#include "ssa.hpp"
 #include "value.hpp"
 
 #include "llvm/ExecutionEngine/Orc/ThreadSafeModule.h"
+#include "llvm/IR/DIBuilder.h"
 #include "llvm/IR/IRBuilder.h"
 
+/**
+ * @brief 宣言された大域変数（`Context::globals` の要素）
+ */
+struct DeclaredGlobal {
+    //! 大域変数の番号（`g<N>` の `N`）
+    unsigned number;
+    std::shared_ptr<value::Type> type;
+    //! 宣言の時点で分かっている初期値（定数に畳み込めなかったなら `std::nullopt`）
+    std::optional<std::int32_t> initial_value;
+    //! 宣言より後の文で代入された回数（コンパイル・評価した時点までの数）
+    unsigned writes;
+    //! 最も外側のループの中で `ssa::Builder` の変数に昇格しているなら，その変数の番号
+    std::optional<unsigned> promoted;
+    //! 昇格している間に書き込まれたか（ループを出るときに書き戻す必要があるか）
+    bool promoted_written;
+};
+
+namespace expression {
+    class Expression;
+}
+
+/**
+ * @brief 現在の基本ブロックで計算済みの副作用の無い式
+ */
+struct AvailableExpression {
+    //! 計算した式（構造の番号が衝突していないか確かめる）
+    const expression::Expression *expression;
+    std::shared_ptr<value::Type> type;
+    //! 値（`ssa::Builder` が自明な `phi` を消して置き換えても追従する）
+    llvm::WeakTrackingVH llvm_value;
+    //! 式が読んだ変数の名前（どれかに代入されたら使えなくなる）
+    std::vector<std::string> reads;
+};
+
 /**
  * @brief コンパイルに必要な Context 等を関数間で取り回しやすくするためのクラス．
  * @todo `Context` に何をどこまで含めるか，層に分離する必要がないかは要検討．
  */
 struct Context {
+    /**
+     * @brief モジュールを作る `llvm::LLVMContext`
+     *
+     * `llvm::LLVMContext` は一意化した定数・型・メタデータを解放しないので，
+     * `context_lifetime` 個のモジュールごとに新しいものに取り替える（`next_module()`）．
+     * 古いものは，それで作ったモジュールがすべてコンパイルされて捨てられたときに解放される．
+     */
     llvm::orc::ThreadSafeContext context;
-    llvm::IRBuilder<llvm::ConstantFolder, llvm::IRBuilderDefaultInserter> builder;
-    std::unordered_map<std::string, std::pair<unsigned, std::shared_ptr<value::Type>>> global_variables;
+    //! `context` の上の IR ビルダー（`context` を取り替えるときに作り直す）
+    std::unique_ptr<llvm::IRBuilder<llvm::ConstantFolder, llvm::IRBuilderDefaultInserter>> builder;
+    /**
+     * @brief 宣言された大域変数（`Binding::index` で引く）
+     *
+     * `std::deque` なので，後から宣言が増えても要素を指すポインタは変わらない．
+     */
+    std::deque<DeclaredGlobal> globals;
     std::unique_ptr<llvm::Module> module;
     unsigned current_module_number;
+    /**
+     * @brief 大域変数 `g<N>` のリンケージ．
+     *
+     * 文ごとにモジュールを分けるときは他のモジュールから参照されるので `ExternalLinkage`．
+     * ファイル全体を 1 つのモジュールにまとめるとき（`program_module()`）は `InternalLinkage`．
+     */
+    llvm::GlobalValue::LinkageTypes linkage;
+    /**
+     * @brief 副作用も実行時エラーも無い `&&` `||` の右辺や `if` の単純な代入を，分岐せずに `and` `or` `select` にするか．
+     *
+     * `expression::Expression::is_speculatable()` を参照．
+     */
+    bool branchless;
+    /**
+     * @brief 何個のモジュールを作るごとに `context` を取り替えるか（0 なら取り替えない）
+     *
+     * 文ごとのモジュールが互いに引き継ぐのは大域変数の名前と `value::Type` だけなので，いつでも取り替えられる．
+     * ただし，作ったモジュールを 1 つに結合する場合（`llvm::Linker`）は，すべて同じ `context` でなければならない．
+     */
+    unsigned context_lifetime;
+    //! コンパイル中の関数のローカル変数の SSA 形式
+    ssa::Builder ssa;
+    /**
+     * @brief コンパイル中の最も外側のループの直前の基本ブロック（ループの外なら `nullptr`）
+     *
+     * ループの中で参照された大域変数は，ここで一度だけ読み込んで昇格する（`promote_global()`）．
+     */
+    llvm::BasicBlock *loop_preheader;
+    //! 最も外側のループの中で昇格した大域変数
+    std::vector<DeclaredGlobal *> promoted_globals;
+    //! 最も外側のループの中で実行時エラーを報告する呼び出し（`check_divisor()`）
+    std::vector<llvm::CallInst *> loop_reports;
+    /**
+     * @brief コンパイル中に識別子として読んだ変数の名前（読んだ順）
+     *
+     * 式をコンパイルする前後の長さを比べれば，その式が読んだ変数が分かる．
+     */
+    std::vector<std::string> read_variables;
+    /**
+     * @brief 宣言し直されて，もう新しい文からは参照されない大域変数の番号
+     *
+     * 宣言し直した文を実行し終えたら，誰も参照しないので `JIT::release_global()` で解放してよい．
+     */
+    std::vector<unsigned> retired_globals;
+    /**
+     * @brief 実行回数を数えるカウンタ（`nullptr` なら数えるコードを生成しない）
+     *
+     * `count()` を参照．
+     */
+    Counters *counters;
+    /**
+     * @brief 文の関数名に，文が始まる行を付けるか（`function_name()`）
+     *
+     * JIT の機械語を perf や GDB に登録するとき，関数がどの行の文かを名前で分かるようにする．
+     */
+    bool source_names;
+    /**
+     * @brief DWARF のデバッグ情報を生成するか（`-g`）
+     *
+     * モジュールごとにコンパイル単位を作り，文の関数 `f<N>` を `DISubprogram`，大域変数 `g<N>` を `DIGlobalVariable` にする．
+     * 各命令には，それを生成した文や式の開始位置を付ける（`set_location()`）．
+     */
+    bool debug_info;
+    //! デバッグ情報に書くソースファイルの名前
+    std::string source_file;
+    //! 文の本文を切り出すソースコード（`Lexer::get_log()`．`nullptr` なら本文で文を識別しない）
+    const std::vector<std::string> *source;
+    /**
+     * @brief `--pgo-gen` で分岐の回数を書き込むカウンタ（`nullptr` なら数えない）
+     *
+     * `profile_entry()` `profile_branch()` を参照．
+     */
+    pgo::Instrumentation *pgo_instrumentation;
+    //! `--pgo-use` で読み込んだプロファイル（`nullptr` なら使わない）
+    const pgo::Profile *pgo_profile;
+    //! `--remarks` で最適化のリマークを報告する先（`nullptr` なら報告しない）
+    Remarks *remarks;
+private:
+    /**
+     * @brief `available_block` で計算済みの式（`expression::Expression::structure` から引く）
+     *
+     * 基本ブロックが変わったら全て捨てる．変数への代入や宣言があれば，その名前を読む式だけを捨てる．
+     */
+    std::unordered_map<std::size_t, AvailableExpression> available_expressions;
+    llvm::BasicBlock *available_block;
+    //! 一度も代入されていない前提で定数に置き換える予定の `load` と，その大域変数の番号と値
+    std::vector<std::tuple<llvm::LoadInst *, unsigned, std::int32_t>> speculated_loads;
+    //! 現在のモジュールで代入された大域変数の番号
+    std::unordered_set<unsigned> written_globals;
+    //! 今の `context` で作ったモジュールの数
+    unsigned modules_in_context;
+    //! 今のモジュールの文が始まる行（1-indexed．`set_source()` していなければ 0）
+    std::size_t source_line;
+    //! 今のモジュールのデバッグ情報（`debug_info` でなければ `nullptr`）
+    std::unique_ptr<llvm::DIBuilder> debug_builder;
+    llvm::DICompileUnit *compile_unit;
+    //! コンパイル中の関数の `DISubprogram`（命令の位置のスコープ）
+    llvm::DISubprogram *subprogram;
+    //! 今の文の本文のハッシュ（`set_source()`．`pgo::Site` の前半）
+    std::uint64_t sentence_hash;
+    //! 今の文の中で次にコンパイルする分岐の番号（`pgo::Site` の後半）
+    unsigned next_site;
+    void renew_context();
+    void start_debug_info();
+    void increment(std::uint64_t *, llvm::Value *);
 public:
-    llvm::Module &next_module(), &get_module();
+    llvm::Module &next_module(), &program_module(), &get_module();
+    void next_sentence();
+    void set_source(const pos::Range &);
+    void start_function(llvm::Function *, const pos::Range &);
+    void set_location(const pos::Range &);
+    void describe_global(llvm::GlobalVariable *, const std::string &, value::Type &, const pos::Range &);
     std::unique_ptr<llvm::Module> take_module();
     unsigned get_module_number();
     std::string function_name(), global_variable_name();
     std::string function_name(unsigned), global_variable_name(unsigned);
+    llvm::GlobalVariable *global_variable(unsigned, llvm::Type *);
+    llvm::MDNode *global_tbaa(unsigned, value::Type &);
+    void count(pos::Range, llvm::Value * = nullptr);
+    void profile_entry(llvm::Function *);
+    llvm::MDNode *profile_branch(llvm::Value *);
+    llvm::Value *load_global(unsigned, value::Type &);
+    void store_global(unsigned, value::Type &, llvm::Value *);
+    llvm::Value *load_global(DeclaredGlobal &);
+    void store_global(DeclaredGlobal &, llvm::Value *);
+    void resolve_speculated_loads();
+    std::optional<value::Value> find_available(const expression::Expression &);
+    void make_available(const expression::Expression &, const value::Value &, std::size_t);
+    void invalidate_available(const std::string &);
+    DeclaredGlobal &define_global(unsigned, DeclaredGlobal);
+    void retire_global(unsigned);
+    unsigned promote_global(DeclaredGlobal &);
+    void write_back_promoted_globals();
+    void check_divisor(llvm::Value *, const pos::Range &);
     Context();
 };
 
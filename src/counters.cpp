@@ -0,0 +1,47 @@
+/**
+ * @file counters.cpp
+ */
+#include "counters.hpp"
+
+#include <algorithm>
+#include <unordered_map>
+
+//! `report()` で報告する行の数
+static constexpr std::size_t HOT_LINES = 10;
+
+/**
+ * @brief `range` の位置のカウンタを 0 で初期化して確保する．
+ * @return カウンタのアドレス（この `Counters` が破棄されるまで変わらない）
+ */
+std::uint64_t *Counters::add(pos::Range range){
+    ranges.push_back(std::move(range));
+    return &values.emplace_back(0);
+}
+
+/**
+ * @brief 最も多く実行された `HOT_LINES` 行を，回数の多い順に標準エラー出力に出力する．
+ *
+ * 同じ行から始まるカウンタが複数あれば（文と，その中の分岐や繰り返しなど），最も多いものをその行の回数とする．
+ * 行は `error::Error::eprint()` と同じく，入力の記録（`Lexer::get_log()`）から範囲を示して出力する．
+ * @param log 今までに読んだ入力の記録
+ */
+void Counters::report(const std::vector<std::string> &log) const {
+    std::unordered_map<std::size_t, std::size_t> hottest;
+    for(std::size_t i = 0; i < values.size(); ++i){
+        if(values[i] == 0) continue;
+        auto [line, inserted] = hottest.try_emplace(ranges[i].get_start().into_inner().first, i);
+        if(!inserted && values[i] > values[line->second]) line->second = i;
+    }
+    std::vector<std::size_t> counters;
+    for(auto &[line, counter] : hottest) counters.push_back(counter);
+    std::sort(counters.begin(), counters.end(), [this](std::size_t left, std::size_t right){
+        if(values[left] != values[right]) return values[left] > values[right];
+        return ranges[left].get_start().into_inner() < ranges[right].get_start().into_inner();
+    });
+    if(counters.size() > HOT_LINES) counters.resize(HOT_LINES);
+    std::cerr << "hot lines:" << std::endl;
+    for(auto counter : counters){
+        std::cerr << values[counter] << " times at " << ranges[counter] << std::endl;
+        ranges[counter].eprint(log);
+    }
+}
@@ -0,0 +1,34 @@
+/**
+ * @file counters.hpp
+ * @brief 文や分岐の実行回数を数える
+ */
+#ifndef COUNTERS_HPP
+#define COUNTERS_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <vector>
+
+#include "pos.hpp"
+
+/**
+ * @brief `--counters` で，ソースコードのどこが何回実行されたかを数えるクラス．
+ *
+ * コンパイルするときに位置ごとにカウンタを確保し（`add()`），
+ * 生成したコードはそのアドレスの 64 ビット整数を直接 1 増やす（`Context::count()`）．
+ * JIT で実行するコードはすべて同じスレッドで動くので，加算はアトミックにしない．
+ * 最後に，最も多く実行された行を報告する（`report()`）．
+ */
+class Counters {
+    //! カウンタの値（`std::deque` なので，後から増えても機械語に埋め込んだアドレスは変わらない）
+    std::deque<std::uint64_t> values;
+    //! カウンタごとのソースコード中の位置
+    std::vector<pos::Range> ranges;
+public:
+    std::uint64_t *add(pos::Range);
+    void report(const std::vector<std::string> &) const;
+};
+
+#endif
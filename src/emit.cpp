@@ -0,0 +1,196 @@
+/**
+ * @file emit.cpp
+ */
+#include "emit.hpp"
+
+#include <iostream>
+
+#include "memstats.hpp"
+#include "optimizer.hpp"
+#include "runtime.hpp"
+
+#include "llvm/Bitcode/BitcodeWriter.h"
+#include "llvm/Config/llvm-config.h"
+#include "llvm/IR/LegacyPassManager.h"
+#include "llvm/MC/SubtargetFeature.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Host.h"
+#include "llvm/Support/Program.h"
+#include "llvm/Support/TargetSelect.h"
+#include "llvm/Support/TimeProfiler.h"
+#include "llvm/Target/TargetMachine.h"
+#include "llvm/Target/TargetOptions.h"
+#if LLVM_VERSION_MAJOR >= 14
+#include "llvm/MC/TargetRegistry.h"
+#else
+#include "llvm/Support/TargetRegistry.h"
+#endif
+
+/**
+ * @brief 生成したコードが宣言した実行時の関数（`runtime`）を，JIT の代わりに `module` の中で定義する．
+ *
+ * `runtime::DIVISION_BY_ZERO` は `division by zero at <位置>` を標準エラー出力に出力し，終了コード 1 で終了する．
+ * 位置の書式は `pos::Range` の `operator<<` と同じ．
+ */
+static void define_runtime(Context &context, llvm::Module &module){
+    auto function = module.getFunction(runtime::DIVISION_BY_ZERO);
+    if(!function) return;
+    auto &llvm_context = *context.context.getContext();
+    auto &builder = *context.builder;
+    function->setLinkage(llvm::GlobalValue::InternalLinkage);
+    builder.SetInsertPoint(llvm::BasicBlock::Create(llvm_context, "", function));
+    builder.SetCurrentDebugLocation(llvm::DebugLoc());
+    auto int32_type = builder.getInt32Ty();
+    auto print = module.getOrInsertFunction("dprintf", llvm::FunctionType::get(int32_type, {int32_type, builder.getInt8PtrTy()}, true));
+    auto exit = module.getOrInsertFunction("exit", llvm::FunctionType::get(builder.getVoidTy(), {int32_type}, false));
+    auto one = builder.getInt64(1);
+    auto arguments = function->arg_begin();
+    builder.CreateCall(print, {
+        builder.getInt32(2),
+        builder.CreateGlobalStringPtr("division by zero at %lld:%lld-%lld:%lld\n"),
+        builder.CreateAdd(&arguments[0], one),
+        builder.CreateAdd(&arguments[1], one),
+        builder.CreateAdd(&arguments[2], one),
+        &arguments[3]
+    });
+    builder.CreateCall(exit, {builder.getInt32(1)});
+    builder.CreateUnreachable();
+}
+
+/**
+ * @brief 実行ファイル用の `main` を追加する．
+ *
+ * `main` は各文の関数 `f1` … `fN` を順に呼び出し，0 を返す．
+ * 定数で初期化する宣言など，関数を作らなかった文は飛ばす．
+ * 実行時の関数もここで定義する（`define_runtime()`）．
+ * @param module 各文のモジュールを結合したもの
+ */
+void add_entry_point(Context &context, llvm::Module &module){
+    define_runtime(context, module);
+    auto &llvm_context = *context.context.getContext();
+    auto main_function = llvm::Function::Create(
+        llvm::FunctionType::get(llvm::Type::getInt32Ty(llvm_context), {}, false),
+        llvm::Function::ExternalLinkage,
+        "main",
+        module
+    );
+    context.builder->SetInsertPoint(llvm::BasicBlock::Create(llvm_context, "", main_function));
+    for(unsigned i = 1; i <= context.get_module_number(); ++i){
+        if(auto callee = module.getFunction(context.function_name(i))) context.builder->CreateCall(callee);
+    }
+    context.builder->CreateRet(context.builder->getInt32(0));
+}
+
+/**
+ * @brief `option.cpu` 向けの `llvm::TargetMachine` を作る．
+ * @retval nullptr ターゲットが見つからなかった（理由を標準エラー出力に出力済み）
+ */
+static std::unique_ptr<llvm::TargetMachine> create_target_machine(const std::string &cpu_option){
+    llvm::InitializeNativeTarget();
+    llvm::InitializeNativeTargetAsmPrinter();
+    auto triple = llvm::sys::getDefaultTargetTriple();
+    std::string message;
+    auto target = llvm::TargetRegistry::lookupTarget(triple, message);
+    if(!target){
+        std::cerr << message << std::endl;
+        return nullptr;
+    }
+    std::string cpu = cpu_option, features;
+    if(cpu == "native"){
+        cpu = llvm::sys::getHostCPUName().str();
+        llvm::StringMap<bool> host_features;
+        if(llvm::sys::getHostCPUFeatures(host_features)){
+            llvm::SubtargetFeatures subtarget_features;
+            for(auto &feature : host_features){
+                subtarget_features.AddFeature(feature.first(), feature.second);
+            }
+            features = subtarget_features.getString();
+        }
+    }
+    return std::unique_ptr<llvm::TargetMachine>(target->createTargetMachine(
+        triple, cpu, features, llvm::TargetOptions(), llvm::Reloc::PIC_
+    ));
+}
+
+/**
+ * @brief `.o` または `.s` を `output` に書き出す．
+ */
+static bool emit_file(llvm::TargetMachine &target_machine, llvm::Module &module, const std::string &output, llvm::CodeGenFileType file_type){
+    std::error_code error_code;
+    llvm::raw_fd_ostream stream(output, error_code, llvm::sys::fs::OF_None);
+    if(error_code){
+        std::cerr << "cannot open " << output << ": " << error_code.message() << std::endl;
+        return false;
+    }
+    llvm::legacy::PassManager pass_manager;
+    if(target_machine.addPassesToEmitFile(pass_manager, stream, nullptr, file_type)){
+        std::cerr << "the target cannot emit this file type" << std::endl;
+        return false;
+    }
+    pass_manager.run(module);
+    return true;
+}
+
+/**
+ * @brief オブジェクトファイルを一時ファイルに書き出し，システムのリンカ（`cc`）で実行ファイルにする．
+ */
+static bool emit_executable(llvm::TargetMachine &target_machine, llvm::Module &module, const std::string &output){
+    llvm::SmallString<128> object_path;
+    if(auto error_code = llvm::sys::fs::createTemporaryFile("toy_language", "o", object_path)){
+        std::cerr << "cannot create a temporary file: " << error_code.message() << std::endl;
+        return false;
+    }
+    bool ok = emit_file(target_machine, module, std::string(object_path), llvm::CGFT_ObjectFile);
+    if(ok){
+        auto linker = llvm::sys::findProgramByName("cc");
+        if(!linker){
+            std::cerr << "cannot find the linker `cc`" << std::endl;
+            ok = false;
+        }else{
+            llvm::StringRef arguments[] = {linker.get(), object_path, "-o", output};
+            std::string message;
+            if(llvm::sys::ExecuteAndWait(linker.get(), arguments, llvm::None, {}, 0, 0, &message) != 0){
+                std::cerr << "linking failed" << (message.empty() ? "" : ": ") << message << std::endl;
+                ok = false;
+            }
+        }
+    }
+    llvm::sys::fs::remove(object_path);
+    return ok;
+}
+
+/**
+ * @brief 事前コンパイルしたモジュールを最適化し，`option.emit` の形式で `option.output_path()` に書き出す．
+ * @retval false 出力に失敗した（理由を標準エラー出力に出力済み）
+ */
+bool emit(llvm::Module &module, const option::Option &option){
+    auto target_machine = create_target_machine(option.cpu);
+    if(!target_machine) return false;
+    module.setTargetTriple(target_machine->getTargetTriple().str());
+    module.setDataLayout(target_machine->createDataLayout());
+    optimize(module);
+    auto output = option.output_path();
+    llvm::TimeTraceScope scope("Emit", output);
+    memstats::Scope phase(memstats::Phase::Codegen);
+    switch(option.emit.value()){
+        case option::Emit::IR:
+        case option::Emit::Bitcode: {
+            std::error_code error_code;
+            llvm::raw_fd_ostream stream(output, error_code, llvm::sys::fs::OF_None);
+            if(error_code){
+                std::cerr << "cannot open " << output << ": " << error_code.message() << std::endl;
+                return false;
+            }
+            if(option.emit == option::Emit::IR) module.print(stream, nullptr);
+            else llvm::WriteBitcodeToFile(module, stream);
+            return true;
+        }
+        case option::Emit::Assembly:
+            return emit_file(*target_machine, module, output, llvm::CGFT_AssemblyFile);
+        case option::Emit::Object:
+            return emit_file(*target_machine, module, output, llvm::CGFT_ObjectFile);
+        case option::Emit::Executable:
+            return emit_executable(*target_machine, module, output);
+    }
+    return false;
+}
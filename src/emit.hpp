@@ -0,0 +1,14 @@
+/**
+ * @file emit.hpp
+ * @brief 事前コンパイルしたプログラムをファイルに出力する
+ */
+#ifndef EMIT_HPP
+#define EMIT_HPP
+
+#include "context.hpp"
+#include "option.hpp"
+
+void add_entry_point(Context &, llvm::Module &);
+bool emit(llvm::Module &, const option::Option &);
+
+#endif
@@ -119,6 +119,26 @@ namespace error {
      * @param pos 変数の位置
      */
     UndefinedVariable::UndefinedVariable(pos::Range pos): pos(std::move(pos)) {}
+    /**
+     * @brief コンストラクタ
+     * @param pos 型の合わない式の位置
+     */
+    TypeMismatch::TypeMismatch(pos::Range pos): pos(std::move(pos)) {}
+    /**
+     * @brief コンストラクタ
+     * @param pos 代入演算子の左辺の位置
+     */
+    NotAssignable::NotAssignable(pos::Range pos): pos(std::move(pos)) {}
+    /**
+     * @brief コンストラクタ
+     * @param pos 宣言の位置
+     */
+    NoTypeInDeclaration::NoTypeInDeclaration(pos::Range pos): pos(std::move(pos)) {}
+    /**
+     * @brief コンストラクタ
+     * @param pos 除算の式の位置（分からなければ `std::nullopt`）
+     */
+    DivisionByZero::DivisionByZero(std::optional<pos::Range> pos): pos(std::move(pos)) {}
 
     void UnexpectedCharacter::eprint(const std::vector<std::string> &log) const {
         std::cerr << "unexpected character at " << pos << std::endl;
@@ -226,4 +246,24 @@ namespace error {
         std::cerr << "undefined variable at " << pos << std::endl;
         pos.eprint(log);
     }
+    void TypeMismatch::eprint(const std::vector<std::string> &log) const {
+        std::cerr << "type mismatch at " << pos << std::endl;
+        pos.eprint(log);
+    }
+    void NotAssignable::eprint(const std::vector<std::string> &log) const {
+        std::cerr << "cannot assign to the expression at " << pos << std::endl;
+        pos.eprint(log);
+    }
+    void NoTypeInDeclaration::eprint(const std::vector<std::string> &log) const {
+        std::cerr << "neither type nor initializer in the declaration at " << pos << std::endl;
+        pos.eprint(log);
+    }
+    void DivisionByZero::eprint(const std::vector<std::string> &log) const {
+        if(!pos){
+            std::cerr << "division by zero" << std::endl;
+            return;
+        }
+        std::cerr << "division by zero at " << pos.value() << std::endl;
+        pos->eprint(log);
+    }
 }
@@ -206,6 +206,43 @@ namespace error {
         UndefinedVariable(pos::Range);
         void eprint(const std::vector<std::string> &) const override;
     };
+
+    //! 式の型が演算子や宣言，条件の要求する型と合わない
+    class TypeMismatch : public Error {
+        pos::Range pos;
+    public:
+        TypeMismatch(pos::Range);
+        void eprint(const std::vector<std::string> &) const override;
+    };
+
+    //! 代入演算子の左辺が変数ではない
+    class NotAssignable : public Error {
+        pos::Range pos;
+    public:
+        NotAssignable(pos::Range);
+        void eprint(const std::vector<std::string> &) const override;
+    };
+
+    //! 型も初期化の式も無い宣言
+    class NoTypeInDeclaration : public Error {
+        pos::Range pos;
+    public:
+        NoTypeInDeclaration(pos::Range);
+        void eprint(const std::vector<std::string> &) const override;
+    };
+
+    /**
+     * @brief 実行中に 0 で割った（`/` `%` `/=` `%=`）．
+     * `bytecode::apply()`，`runtime::call()`
+     *
+     * `VM` では命令を生成した式の位置（`bytecode::Code::position()`）で報告する．
+     */
+    class DivisionByZero : public Error {
+        std::optional<pos::Range> pos;
+    public:
+        DivisionByZero(std::optional<pos::Range>);
+        void eprint(const std::vector<std::string> &) const override;
+    };
 }
 
 #endif
@@ -3,91 +3,340 @@
  */
 #include "expression.hpp"
 
+#include <limits>
 #include <string_view>
 #include "error.hpp"
 
+#include "llvm/ADT/Hashing.h"
+
 namespace expression {
+    //! 代入演算子なら，対応する演算（単純な代入なら `Assign` のまま）を返す
+    static std::optional<BinaryOperator> assignment(BinaryOperator binary_operator){
+        switch(binary_operator){
+            case BinaryOperator::Assign: return BinaryOperator::Assign;
+            case BinaryOperator::AddAssign: return BinaryOperator::Add;
+            case BinaryOperator::SubAssign: return BinaryOperator::Sub;
+            case BinaryOperator::MulAssign: return BinaryOperator::Mul;
+            case BinaryOperator::DivAssign: return BinaryOperator::Div;
+            case BinaryOperator::RemAssign: return BinaryOperator::Rem;
+            case BinaryOperator::BitAndAssign: return BinaryOperator::BitAnd;
+            case BinaryOperator::BitOrAssign: return BinaryOperator::BitOr;
+            case BinaryOperator::BitXorAssign: return BinaryOperator::BitXor;
+            case BinaryOperator::RightShiftAssign: return BinaryOperator::RightShift;
+            case BinaryOperator::LeftShiftAssign: return BinaryOperator::LeftShift;
+            default: return std::nullopt;
+        }
+    }
+
+    //! 0 で割って実行時エラーになるかもしれない除算・剰余か（`INT_MIN / -1` は折り返すのでエラーにならない）
+    static bool may_trap(BinaryOperator binary_operator, const Expression &divisor){
+        if(binary_operator != BinaryOperator::Div && binary_operator != BinaryOperator::Rem) return false;
+        auto value = divisor.integer_literal();
+        return !value || value.value() == 0;
+    }
+
+    /**
+     * @brief コンストラクタ
+     *
+     * 構造の番号は，節点の種類と演算子，子の番号（葉なら名前や値）のハッシュ．
+     * 構文解析の途中で葉から順に求めるので，同じ構造の部分木には同じ番号が付く．
+     * 番号を表に登録しないので，長く続く対話モードでも文を解放すれば何も残らない．
+     */
+    Expression::Expression(std::size_t structure): structure(structure) {}
     Expression::~Expression() = default;
     //! コンストラクタ
-    Identifier::Identifier(std::string name): name(std::move(name)) {}
+    Identifier::Identifier(std::string name):
+        Expression(llvm::hash_combine('i', name)),
+        name(std::move(name)) {}
     //! コンストラクタ
-    Integer::Integer(std::int32_t value): value(value) {}
+    Integer::Integer(std::int32_t value):
+        Expression(llvm::hash_combine('n', value)),
+        value(value) {}
     //! コンストラクタ
     UnaryOperation::UnaryOperation(
         UnaryOperator unary_operator,
         std::unique_ptr<Expression> operand
     ):
+        Expression(llvm::hash_combine('u', static_cast<int>(unary_operator), operand->structure)),
         unary_operator(unary_operator),
-        operand(std::move(operand)) {}
+        operand(std::move(operand)),
+        pure(this->operand->is_speculatable()) {}
     //! コンストラクタ
     BinaryOperation::BinaryOperation(
         BinaryOperator binary_operator,
         std::unique_ptr<Expression> left,
         std::unique_ptr<Expression> right
     ):
+        Expression(llvm::hash_combine('b', static_cast<int>(binary_operator), left->structure, right->structure)),
         binary_operator(binary_operator),
         left(std::move(left)),
-        right(std::move(right)) {}
-    //! コンストラクタ
+        right(std::move(right)),
+        pure(
+            !assignment(binary_operator)
+                && !may_trap(binary_operator, *this->right)
+                && this->left->is_speculatable()
+                && this->right->is_speculatable()
+        ) {}
+    /**
+     * @brief コンストラクタ
+     *
+     * 括弧は値を変えないので，中の式と同じ構造の番号にする．
+     */
     Group::Group(std::unique_ptr<Expression> expression):
+        Expression(expression->structure),
         expression(std::move(expression)) {}
     //! コンストラクタ
     Invocation::Invocation(
         std::unique_ptr<Expression> function,
         std::vector<std::unique_ptr<Expression>> arguments
     ):
+        Expression([&]{
+            auto ret = llvm::hash_combine('c', function->structure);
+            for(auto &argument : arguments) ret = llvm::hash_combine(ret, argument->structure);
+            return ret;
+        }()),
         function(std::move(function)),
         arguments(std::move(arguments)) {}
 
+    //! 演算子がどの型のオペランドを受け付けるか
+    enum class OperandKind {
+        //! 整数のみ
+        Integer,
+        //! 真偽値のみ
+        Boolean,
+        //! 両辺が同じ型であれば何でもよい
+        Any
+    };
+
+    //! 代入演算子と論理演算子を除く 2 項演算子について，受け付けるオペランドの型と，結果が真偽値になるか
+    static std::pair<OperandKind, bool> operand_kind(BinaryOperator binary_operator){
+        switch(binary_operator){
+            case BinaryOperator::BitAnd:
+            case BinaryOperator::BitOr:
+            case BinaryOperator::BitXor:
+            case BinaryOperator::Assign:
+                return {OperandKind::Any, false};
+            case BinaryOperator::Equal:
+            case BinaryOperator::NotEqual:
+                return {OperandKind::Any, true};
+            case BinaryOperator::Less:
+            case BinaryOperator::Greater:
+            case BinaryOperator::LessEqual:
+            case BinaryOperator::GreaterEqual:
+                return {OperandKind::Integer, true};
+            case BinaryOperator::LogicalAnd:
+            case BinaryOperator::LogicalOr:
+                return {OperandKind::Boolean, true};
+            default:
+                return {OperandKind::Integer, false};
+        }
+    }
+
+    //! オペランドの型が `kind` に合うか
+    static bool matches(OperandKind kind, const std::shared_ptr<value::Type> &left, const std::shared_ptr<value::Type> &right){
+        switch(kind){
+            case OperandKind::Integer: return left->is_integer() && right->is_integer();
+            case OperandKind::Boolean: return left->is_boolean() && right->is_boolean();
+            case OperandKind::Any: return left->is_integer() == right->is_integer() && left->is_boolean() == right->is_boolean();
+        }
+        return false;
+    }
+
+    //! 代入演算子と論理演算子を除く 2 項演算子に対応する命令
+    static bytecode::Opcode opcode(BinaryOperator binary_operator){
+        switch(binary_operator){
+            case BinaryOperator::Add: return bytecode::Opcode::Add;
+            case BinaryOperator::Sub: return bytecode::Opcode::Sub;
+            case BinaryOperator::Mul: return bytecode::Opcode::Mul;
+            case BinaryOperator::Div: return bytecode::Opcode::Div;
+            case BinaryOperator::Rem: return bytecode::Opcode::Rem;
+            case BinaryOperator::LeftShift: return bytecode::Opcode::LeftShift;
+            case BinaryOperator::RightShift: return bytecode::Opcode::RightShift;
+            case BinaryOperator::BitAnd: return bytecode::Opcode::BitAnd;
+            case BinaryOperator::BitOr: return bytecode::Opcode::BitOr;
+            case BinaryOperator::BitXor: return bytecode::Opcode::BitXor;
+            case BinaryOperator::Equal: return bytecode::Opcode::Equal;
+            case BinaryOperator::NotEqual: return bytecode::Opcode::NotEqual;
+            case BinaryOperator::Less: return bytecode::Opcode::Less;
+            case BinaryOperator::Greater: return bytecode::Opcode::Greater;
+            case BinaryOperator::LessEqual: return bytecode::Opcode::LessEqual;
+            default: return bytecode::Opcode::GreaterEqual;
+        }
+    }
+
     /**
      * @brief 単一の識別子からなる式なら，識別子名を返す．
      * @retval std::nullopt 単一の識別子からなる式ではない
      */
     std::optional<std::string> Expression::identifier() { return std::nullopt; }
-    std::optional<std::string> Identifier::identifier() { return std::move(name); }
+    std::optional<std::string> Identifier::identifier() { return name; }
 
     /**
-     * @brief 識別子をコンパイルする．
+     * @brief 単一の識別子からなる式なら，名前解決の結果を返す．
+     * @retval std::nullopt 単一の識別子からなる式ではない
+     */
+    std::optional<Binding> Expression::binding() const { return std::nullopt; }
+    std::optional<Binding> Identifier::binding() const { return resolved; }
+
+    /**
+     * @brief 識別子の名前を解決する．
+     * @throw error::UndefinedVariable 宣言されていない
+     */
+    void Identifier::resolve(Resolver &resolver){
+        auto found = resolver.find(name);
+        if(!found) throw error::make<error::UndefinedVariable>(pos.clone());
+        resolved = found.value();
+    }
+    void Integer::resolve(Resolver &){}
+    void UnaryOperation::resolve(Resolver &resolver){ operand->resolve(resolver); }
+    /**
+     * @brief 2 項演算の名前を解決する．
      *
-     * 名前を `local_variables`，`global_variables` の順に検索する．
+     * 代入演算子はコンパイルと同じく右辺を先に解決する．
+     */
+    void BinaryOperation::resolve(Resolver &resolver){
+        if(assignment(binary_operator)){
+            right->resolve(resolver);
+            left->resolve(resolver);
+        }else{
+            left->resolve(resolver);
+            right->resolve(resolver);
+        }
+    }
+    void Group::resolve(Resolver &resolver){ expression->resolve(resolver); }
+    void Invocation::resolve(Resolver &resolver){
+        function->resolve(resolver);
+        for(auto &argument : arguments) argument->resolve(resolver);
+    }
+
+    /**
+     * @brief 単一の整数リテラル（括弧でくくられていてもよい）なら，その値を返す．
+     * @retval std::nullopt 整数リテラルではない
+     */
+    std::optional<std::int32_t> Expression::integer_literal() const { return std::nullopt; }
+    std::optional<std::int32_t> Integer::integer_literal() const { return value; }
+    std::optional<std::int32_t> Group::integer_literal() const { return expression->integer_literal(); }
+
+    /**
+     * @brief 副作用も実行時エラーも無く，結果を使わなくても先に評価してよい式か．
      *
-     * `local_variables` に見つかったら…… `value::Value` に `type` と `pointer` が入っているので，
-     * 1. `type` に `context` を渡して `llvm_type` を得る．
-     * 2. `builder` に `llvm_type` と `pointer` を渡して `createLoad` を呼び出す．
+     * 代入，関数呼び出し，0 かもしれない値での除算・剰余を含まなければ真．
+     * 真なら `&&` `||` の右辺を短絡せずに評価しても結果は変わらない．
+     * 演算の結果はコンストラクタで子の結果から求めておく（`pure`）．
+     */
+    bool Identifier::is_speculatable() const { return true; }
+    bool Integer::is_speculatable() const { return true; }
+    bool UnaryOperation::is_speculatable() const { return pure; }
+    bool BinaryOperation::is_speculatable() const { return pure; }
+    bool Group::is_speculatable() const { return expression->is_speculatable(); }
+    bool Invocation::is_speculatable() const { return false; }
+
+    /**
+     * @brief `other` と構造が同じか（`structure` が同じでも構造が違うことがある）．
      *
-     * `local_variables` に見つからず，`global_variables` に見つかったら…… `module_number` と `type` が入っているので，
-     * 1. `module_number` から `global_variable_name` を得る．
-     * 2. `type` に `context` を渡して `llvm_type` を得る．
-     * 3. `module`，`llvm_type`，`global_variable_name` を渡して `pointer = new llvm::GlobalVariable` を作る．
-     * 4. `builder` に `llvm_type` と `pointer` を渡して `createLoad` を呼び出す．
-     * 5. `local_variables` に `type` と `pointer` を保存する．
+     * 括弧の有無は区別しない．
+     */
+    bool Expression::same_structure(const Expression &other) const {
+        return structure == other.structure && ungrouped().same_node(other.ungrouped());
+    }
+    //! 括弧を外した式
+    const Expression &Expression::ungrouped() const { return *this; }
+    const Expression &Group::ungrouped() const { return expression->ungrouped(); }
+    bool Identifier::same_node(const Expression &other) const {
+        auto identifier = dynamic_cast<const Identifier *>(&other);
+        return identifier && identifier->name == name;
+    }
+    bool Integer::same_node(const Expression &other) const {
+        auto integer = dynamic_cast<const Integer *>(&other);
+        return integer && integer->value == value;
+    }
+    bool UnaryOperation::same_node(const Expression &other) const {
+        auto unary = dynamic_cast<const UnaryOperation *>(&other);
+        return unary && unary->unary_operator == unary_operator && operand->same_structure(*unary->operand);
+    }
+    bool BinaryOperation::same_node(const Expression &other) const {
+        auto binary = dynamic_cast<const BinaryOperation *>(&other);
+        return binary
+            && binary->binary_operator == binary_operator
+            && left->same_structure(*binary->left)
+            && right->same_structure(*binary->right);
+    }
+    bool Group::same_node(const Expression &other) const { return expression->same_node(other); }
+    bool Invocation::same_node(const Expression &other) const {
+        auto invocation = dynamic_cast<const Invocation *>(&other);
+        if(!invocation || invocation->arguments.size() != arguments.size()) return false;
+        if(!function->same_structure(*invocation->function)) return false;
+        for(std::size_t i = 0; i < arguments.size(); ++i){
+            if(!arguments[i]->same_structure(*invocation->arguments[i])) return false;
+        }
+        return true;
+    }
+
+    /**
+     * @brief 識別子への単純な代入 `x = a`（括弧でくくられていてもよい）なら，その式を返す．
+     * @retval nullptr 単純な代入ではない
+     */
+    BinaryOperation *Expression::simple_assignment() { return nullptr; }
+    BinaryOperation *BinaryOperation::simple_assignment() {
+        if(binary_operator == BinaryOperator::Assign && left->identifier()) return this;
+        return nullptr;
+    }
+    BinaryOperation *Group::simple_assignment() { return expression->simple_assignment(); }
+
+    /**
+     * @brief 名前解決済みの変数．
      *
-     * どちらにも見つからなかったら…… `error::UndefinedVariable` を投げる．
+     * ローカル変数とループの中で昇格した大域変数は `ssa::Builder` の変数として，
+     * それ以外の大域変数は `g<N>` への `load` `store` として読み書きする．
      */
-    value::Value Identifier::compile(Context &context, std::unordered_map<std::string, value::Value> &local_variables){
-        auto local = local_variables.find(name);
-        std::shared_ptr<value::Type> return_type;
-        llvm::Value *return_value;
-        if(local != local_variables.end()){
-        }else{
-            auto global = context.global_variables.find(name);
-            if(global != context.global_variables.end()){
-                auto llvm_type = global->second.second->llvm_type(*context.context.getContext());
-                auto pointer = new llvm::GlobalVariable(
-                    context.get_module(),
-                    llvm_type,
-                    false,
-                    llvm::GlobalValue::ExternalLinkage,
-                    nullptr,
-                    context.global_variable_name(global->second.first)
-                );
-                return_type = global->second.second;
-                return_value = context.builder.CreateLoad(llvm_type, pointer);
-            }else{
-                throw error::make<error::UndefinedVariable>(std::move(pos));
-            }
+    struct VariableReference {
+        std::shared_ptr<value::Type> type;
+        //! `ssa::Builder` の変数の番号（昇格していない大域変数なら `std::nullopt`）
+        std::optional<unsigned> local;
+        //! 大域変数（`Context::globals` の要素．ローカル変数なら `nullptr`）
+        DeclaredGlobal *global;
+        //! 現在の位置での値を読む
+        llvm::Value *load(Context &context){
+            if(local) return context.ssa.read(local.value(), context.builder->GetInsertBlock());
+            return context.load_global(*global);
+        }
+        //! 現在の位置で値を書き込む
+        void store(Context &context, llvm::Value *value){
+            if(global && global->promoted) global->promoted_written = true;
+            if(local) context.ssa.write(local.value(), context.builder->GetInsertBlock(), value);
+            else context.store_global(*global, value);
+        }
+    };
+
+    /**
+     * @brief 名前解決の結果から変数を得る．
+     *
+     * ループの中で初めて参照された大域変数はその場で昇格する（`Context::promote_global()`）．
+     */
+    static VariableReference find_variable(Context &context, std::vector<Variable> &local_variables, const Binding &binding){
+        if(binding.kind == Binding::Kind::Local){
+            auto &local = local_variables[binding.index];
+            return {local.type, local.index, nullptr};
         }
-        return value::Value(std::move(return_type), return_value);
+        auto &global = context.globals[binding.index];
+        if(global.promoted) return {global.type, global.promoted, &global};
+        if(context.loop_preheader) return {global.type, context.promote_global(global), &global};
+        return {global.type, std::nullopt, &global};
+    }
+
+    /**
+     * @brief 識別子をコンパイルする．
+     *
+     * 名前は解決済みなので，`Binding` から直接変数を得る（`find_variable()`）．
+     * ローカル変数は `alloca` を経由せず，`ssa::Builder` が現在の値（必要なら `phi`）を返す．
+     * 大域変数は `load` する（ループの中では昇格した変数として読む）．
+     * 読んだ名前は `Context::read_variables` に記録する（計算済みの式を無効化するため）．
+     */
+    value::Value Identifier::compile(Context &context, std::vector<Variable> &local_variables){
+        context.set_location(pos);
+        auto variable = find_variable(context, local_variables, resolved);
+        context.read_variables.push_back(name);
+        return value::Value(variable.type, variable.load(context));
     }
     /**
      * @brief 整数リテラルをコンパイルする．
@@ -96,13 +345,460 @@ namespace expression {
      * - `context` から `getInt32Ty` して，`llvm::ConstantInt` を使う
      * - `builder` の `getInt32` を使う
      */
-    value::Value Integer::compile(Context &context, std::unordered_map<std::string, value::Value> &){
-        return value::make<value::Integer>(context.builder.getInt32(value));
+    value::Value Integer::compile(Context &context, std::vector<Variable> &){
+        return value::make<value::Integer>(context.builder->getInt32(value));
+    }
+
+    /**
+     * @brief 識別子をバイトコードにコンパイルする．
+     *
+     * ローカル変数はそのレジスタを，大域変数は `LoadGlobal` で読み込んだ値を新しいレジスタにコピーして返す．
+     */
+    Register Identifier::compile_bytecode(Context &context, bytecode::Builder &builder, std::vector<Register> &local_registers){
+        auto ret = builder.new_register();
+        if(resolved.kind == Binding::Kind::Local){
+            auto &local = local_registers[resolved.index];
+            builder.emit(bytecode::Opcode::Move, ret, local.index);
+            return {ret, local.type};
+        }
+        auto &global = context.globals[resolved.index];
+        auto number = static_cast<std::int32_t>(global.number);
+        builder.use_global(number);
+        builder.emit(bytecode::Opcode::LoadGlobal, ret, number);
+        return {ret, global.type};
+    }
+    //! 整数リテラルをバイトコードにコンパイルする．
+    Register Integer::compile_bytecode(Context &, bytecode::Builder &builder, std::vector<Register> &){
+        auto ret = builder.new_register();
+        builder.emit(bytecode::Opcode::Constant, ret, value);
+        return {ret, std::make_shared<value::Integer>()};
+    }
+    /**
+     * @brief 単項演算をバイトコードにコンパイルする．
+     * @throw error::TypeMismatch `!` のオペランドが真偽値でない，またはそれ以外のオペランドが整数でない
+     */
+    Register UnaryOperation::compile_bytecode(Context &context, bytecode::Builder &builder, std::vector<Register> &local_registers){
+        auto operand_register = operand->compile_bytecode(context, builder, local_registers);
+        bool boolean_operator = unary_operator == UnaryOperator::LogicalNot;
+        if(boolean_operator ? !operand_register.type->is_boolean() : !operand_register.type->is_integer()){
+            throw error::make<error::TypeMismatch>(operand->pos.clone());
+        }
+        switch(unary_operator){
+            case UnaryOperator::Plus: return operand_register;
+            case UnaryOperator::Minus: builder.emit(bytecode::Opcode::Minus, operand_register.index, operand_register.index); break;
+            case UnaryOperator::LogicalNot: builder.emit(bytecode::Opcode::LogicalNot, operand_register.index, operand_register.index); break;
+            case UnaryOperator::BitNot: builder.emit(bytecode::Opcode::BitNot, operand_register.index, operand_register.index);
+        }
+        return operand_register;
+    }
+
+
+    /**
+     * @brief 単項演算をコンパイルする．
+     *
+     * 副作用の無い式は，同じ基本ブロックで同じ構造の式を計算済みならその値を使い回す（`Context::find_available()`）．
+     */
+    value::Value UnaryOperation::compile(Context &context, std::vector<Variable> &local_variables){
+        if(!pure) return compile_operation(context, local_variables);
+        if(auto available = context.find_available(*this)) return *available;
+        auto first_read = context.read_variables.size();
+        auto ret = compile_operation(context, local_variables);
+        context.make_available(*this, ret, first_read);
+        return ret;
+    }
+    /**
+     * @brief 単項演算の命令を作る．
+     *
+     * 符号の反転は `sub 0, x` で，オーバーフローは 2 の補数で折り返す（`nsw` を付けない）．
+     * オペランドをコンパイルした後，命令の位置をこの式の位置に戻す（`Context::set_location()`）．
+     * @throw error::TypeMismatch `!` のオペランドが真偽値でない，またはそれ以外のオペランドが整数でない
+     */
+    value::Value UnaryOperation::compile_operation(Context &context, std::vector<Variable> &local_variables){
+        auto ret = operand->compile(context, local_variables);
+        bool boolean_operator = unary_operator == UnaryOperator::LogicalNot;
+        if(boolean_operator ? !ret.type->is_boolean() : !ret.type->is_integer()){
+            throw error::make<error::TypeMismatch>(operand->pos.clone());
+        }
+        context.set_location(pos);
+        switch(unary_operator){
+            case UnaryOperator::Plus: break;
+            case UnaryOperator::Minus: ret.llvm_value = context.builder->CreateNeg(ret.llvm_value); break;
+            case UnaryOperator::LogicalNot:
+            case UnaryOperator::BitNot: ret.llvm_value = context.builder->CreateNot(ret.llvm_value);
+        }
+        return ret;
+    }
+    /**
+     * @brief 代入演算子と論理演算子を除く 2 項演算の命令を作る．
+     *
+     * 意味は `bytecode::apply()` と同じにする．加減乗算は折り返し，シフト量は下位 5 ビットだけを使う．
+     * 除算・剰余は，0 でないと分かっている定数以外の除数を `Context::check_divisor()` で調べて 0 による除算を報告し，
+     * `INT_MIN / -1` は除数を 1 に `select` して `INT_MIN`（剰余は 0）に折り返す．
+     * @param pos 0 による除算を報告する式の位置
+     */
+    static llvm::Value *create_operation(Context &context, BinaryOperator binary_operator, llvm::Value *left, llvm::Value *right, const pos::Range &pos){
+        auto &builder = *context.builder;
+        switch(binary_operator){
+            case BinaryOperator::Add: return builder.CreateAdd(left, right);
+            case BinaryOperator::Sub: return builder.CreateSub(left, right);
+            case BinaryOperator::Mul: return builder.CreateMul(left, right);
+            case BinaryOperator::Div:
+            case BinaryOperator::Rem: {
+                auto divisor = llvm::dyn_cast<llvm::ConstantInt>(right);
+                if(!divisor || divisor->isZero()) context.check_divisor(right, pos);
+                auto dividend = llvm::dyn_cast<llvm::ConstantInt>(left);
+                if((!divisor || divisor->isMinusOne()) && (!dividend || dividend->isMinValue(true))){
+                    auto type = builder.getInt32Ty();
+                    auto overflow = builder.CreateAnd(
+                        builder.CreateICmpEQ(left, llvm::ConstantInt::getSigned(type, std::numeric_limits<std::int32_t>::min())),
+                        builder.CreateICmpEQ(right, llvm::ConstantInt::getSigned(type, -1))
+                    );
+                    right = builder.CreateSelect(overflow, llvm::ConstantInt::get(type, 1), right);
+                }
+                return binary_operator == BinaryOperator::Div ? builder.CreateSDiv(left, right) : builder.CreateSRem(left, right);
+            }
+            case BinaryOperator::LeftShift: return builder.CreateShl(left, builder.CreateAnd(right, 31));
+            case BinaryOperator::RightShift: return builder.CreateAShr(left, builder.CreateAnd(right, 31));
+            case BinaryOperator::BitAnd: return builder.CreateAnd(left, right);
+            case BinaryOperator::BitOr: return builder.CreateOr(left, right);
+            case BinaryOperator::BitXor: return builder.CreateXor(left, right);
+            case BinaryOperator::Equal: return builder.CreateICmpEQ(left, right);
+            case BinaryOperator::NotEqual: return builder.CreateICmpNE(left, right);
+            case BinaryOperator::Less: return builder.CreateICmpSLT(left, right);
+            case BinaryOperator::Greater: return builder.CreateICmpSGT(left, right);
+            case BinaryOperator::LessEqual: return builder.CreateICmpSLE(left, right);
+            default: return builder.CreateICmpSGE(left, right);
+        }
+    }
+    /**
+     * @brief 2 項演算をコンパイルする．
+     *
+     * 副作用の無い式は，同じ基本ブロックで同じ構造の式を計算済みならその値を使い回す（`Context::find_available()`）．
+     */
+    value::Value BinaryOperation::compile(Context &context, std::vector<Variable> &local_variables){
+        if(!pure) return compile_operation(context, local_variables);
+        if(auto available = context.find_available(*this)) return *available;
+        auto first_read = context.read_variables.size();
+        auto ret = compile_operation(context, local_variables);
+        context.make_available(*this, ret, first_read);
+        return ret;
+    }
+    /**
+     * @brief 2 項演算の命令を作る．
+     *
+     * - `&&` `||` は短絡評価する．右辺を `and.rhs` / `or.rhs` に置き，`and.end` / `or.end` の `phi` で合流する．
+     *   ただし `Context::branchless` で右辺が `is_speculatable()` なら，分岐せずに `and` / `or` にする．
+     *   短絡評価の分岐にはプロファイルの重みを付ける（`Context::profile_branch()`）．
+     * - 代入演算子は右辺を評価してから左辺の変数を読み書きする．
+     *
+     * オペランドをコンパイルした後，命令の位置をこの式の位置に戻す（`Context::set_location()`）．
+     * @throw error::TypeMismatch オペランドの型が演算子に合わない
+     * @throw error::NotAssignable 代入演算子の左辺が識別子でない
+     */
+    value::Value BinaryOperation::compile_operation(Context &context, std::vector<Variable> &local_variables){
+        auto &builder = *context.builder;
+        auto &llvm_context = *context.context.getContext();
+        if(binary_operator == BinaryOperator::LogicalAnd || binary_operator == BinaryOperator::LogicalOr){
+            bool is_and = binary_operator == BinaryOperator::LogicalAnd;
+            auto left_value = left->compile(context, local_variables);
+            if(!left_value.type->is_boolean()) throw error::make<error::TypeMismatch>(left->pos.clone());
+            context.set_location(pos);
+            auto profile = context.profile_branch(left_value.llvm_value);
+            if(context.branchless && right->is_speculatable()){
+                auto right_value = right->compile(context, local_variables);
+                if(!right_value.type->is_boolean()) throw error::make<error::TypeMismatch>(right->pos.clone());
+                context.set_location(pos);
+                return value::make<value::Boolean>(is_and
+                    ? builder.CreateAnd(left_value.llvm_value, right_value.llvm_value)
+                    : builder.CreateOr(left_value.llvm_value, right_value.llvm_value));
+            }
+            auto left_block = builder.GetInsertBlock();
+            auto function = left_block->getParent();
+            auto right_block = llvm::BasicBlock::Create(llvm_context, is_and ? "and.rhs" : "or.rhs", function);
+            auto end_block = llvm::BasicBlock::Create(llvm_context, is_and ? "and.end" : "or.end", function);
+            if(is_and) builder.CreateCondBr(left_value.llvm_value, right_block, end_block, profile);
+            else builder.CreateCondBr(left_value.llvm_value, end_block, right_block, profile);
+            context.ssa.seal(right_block);
+            builder.SetInsertPoint(right_block);
+            auto right_value = right->compile(context, local_variables);
+            if(!right_value.type->is_boolean()) throw error::make<error::TypeMismatch>(right->pos.clone());
+            auto right_end_block = builder.GetInsertBlock();
+            context.set_location(pos);
+            builder.CreateBr(end_block);
+            context.ssa.seal(end_block);
+            builder.SetInsertPoint(end_block);
+            auto phi = builder.CreatePHI(builder.getInt1Ty(), 2);
+            phi->addIncoming(builder.getInt1(!is_and), left_block);
+            phi->addIncoming(right_value.llvm_value, right_end_block);
+            return value::make<value::Boolean>(phi);
+        }
+        if(auto operation = assignment(binary_operator)){
+            auto name = left->identifier();
+            if(!name) throw error::make<error::NotAssignable>(left->pos.clone());
+            auto right_value = right->compile(context, local_variables);
+            auto variable = find_variable(context, local_variables, left->binding().value());
+            if(!matches(operand_kind(operation.value()).first, variable.type, right_value.type)){
+                throw error::make<error::TypeMismatch>(pos.clone());
+            }
+            context.set_location(pos);
+            auto value = right_value.llvm_value;
+            if(operation != BinaryOperator::Assign){
+                value = create_operation(context, operation.value(), variable.load(context), value, pos);
+            }
+            variable.store(context, value);
+            context.invalidate_available(name.value());
+            return value::Value(std::move(variable.type), value);
+        }
+        auto left_value = left->compile(context, local_variables);
+        auto right_value = right->compile(context, local_variables);
+        auto [kind, returns_boolean] = operand_kind(binary_operator);
+        if(!matches(kind, left_value.type, right_value.type)){
+            throw error::make<error::TypeMismatch>(pos.clone());
+        }
+        context.set_location(pos);
+        left_value.llvm_value = create_operation(context, binary_operator, left_value.llvm_value, right_value.llvm_value, pos);
+        if(returns_boolean) left_value.type = std::make_shared<value::Boolean>();
+        return left_value;
+    }
+    /**
+     * @brief `if (condition) x = a; else x = b;` を分岐せずに `x = select(condition, a, b)` としてコンパイルする．
+     *
+     * `this` は `x = a`，`otherwise` は `x = b`（else 節が無ければ `nullptr` で，`b` の代わりに `x` の現在の値を使う）．
+     * 両辺が同じ変数への代入で，右辺がどちらも `is_speculatable()` のときだけ行う．
+     * @param weights `select` に付けるプロファイルの重み（無ければ `nullptr`）
+     * @retval false 条件を満たさないので何もしなかった
+     * @throw error::TypeMismatch 右辺の型が変数の型と合わない
+     */
+    bool BinaryOperation::compile_select(Context &context, std::vector<Variable> &local_variables, llvm::Value *condition, BinaryOperation *otherwise, llvm::MDNode *weights){
+        auto name = left->identifier().value();
+        auto binding = left->binding().value();
+        if(!right->is_speculatable()) return false;
+        if(otherwise){
+            auto otherwise_binding = otherwise->left->binding().value();
+            if(otherwise_binding.kind != binding.kind || otherwise_binding.index != binding.index) return false;
+            if(!otherwise->right->is_speculatable()) return false;
+        }
+        auto then_value = right->compile(context, local_variables);
+        auto variable = find_variable(context, local_variables, binding);
+        if(!matches(OperandKind::Any, variable.type, then_value.type)) throw error::make<error::TypeMismatch>(pos.clone());
+        llvm::Value *else_value = nullptr;
+        if(otherwise){
+            auto value = otherwise->right->compile(context, local_variables);
+            if(!matches(OperandKind::Any, variable.type, value.type)) throw error::make<error::TypeMismatch>(otherwise->pos.clone());
+            else_value = value.llvm_value;
+        }
+        context.set_location(pos);
+        if(!else_value) else_value = variable.load(context);
+        auto select = context.builder->CreateSelect(condition, then_value.llvm_value, else_value);
+        if(auto instruction = llvm::dyn_cast<llvm::SelectInst>(select); instruction && weights){
+            instruction->setMetadata(llvm::LLVMContext::MD_prof, weights);
+        }
+        variable.store(context, select);
+        context.invalidate_available(name);
+        return true;
+    }
+    //! 括弧でくくられた式をコンパイルする．
+    value::Value Group::compile(Context &context, std::vector<Variable> &local_variables){
+        return expression->compile(context, local_variables);
+    }
+    /**
+     * @brief 関数呼び出しをコンパイルする．
+     * @throw error::TypeMismatch 関数型がまだ無いので常に投げる
+     */
+    value::Value Invocation::compile(Context &, std::vector<Variable> &){
+        throw error::make<error::TypeMismatch>(function->pos.clone());
+    }
+
+    /**
+     * @brief 2 項演算をバイトコードにコンパイルする．
+     *
+     * - `&&` `||` は短絡評価する．左辺が比較なら比較と分岐のスーパー命令になる．
+     * - 代入演算子は右辺を評価してから左辺の変数を読み書きする．
+     *   大域変数への `+=` は読み込み・加算・書き込みのスーパー命令 `AddGlobal` になる．
+     * @throw error::TypeMismatch オペランドの型が演算子に合わない
+     * @throw error::NotAssignable 代入演算子の左辺が識別子でない
+     */
+    Register BinaryOperation::compile_bytecode(Context &context, bytecode::Builder &builder, std::vector<Register> &local_registers){
+        if(binary_operator == BinaryOperator::LogicalAnd || binary_operator == BinaryOperator::LogicalOr){
+            bool is_and = binary_operator == BinaryOperator::LogicalAnd;
+            auto ret = builder.new_register();
+            auto left_register = left->compile_bytecode(context, builder, local_registers);
+            if(!left_register.type->is_boolean()) throw error::make<error::TypeMismatch>(left->pos.clone());
+            auto short_circuit = is_and ? builder.emit_jump_unless(left_register.index) : builder.emit_jump_if(left_register.index);
+            auto right_register = right->compile_bytecode(context, builder, local_registers);
+            if(!right_register.type->is_boolean()) throw error::make<error::TypeMismatch>(right->pos.clone());
+            builder.emit(bytecode::Opcode::Move, ret, right_register.index);
+            auto end = builder.emit_jump();
+            builder.set_target(short_circuit);
+            builder.emit(bytecode::Opcode::Constant, ret, is_and ? 0 : 1);
+            builder.set_target(end);
+            return {ret, std::make_shared<value::Boolean>()};
+        }
+        if(auto operation = assignment(binary_operator)){
+            auto name = left->identifier();
+            if(!name) throw error::make<error::NotAssignable>(left->pos.clone());
+            auto right_register = right->compile_bytecode(context, builder, local_registers);
+            auto binding = left->binding().value();
+            std::optional<std::int32_t> global_number;
+            std::shared_ptr<value::Type> type;
+            if(binding.kind == Binding::Kind::Local){
+                type = local_registers[binding.index].type;
+            }else{
+                auto &global = context.globals[binding.index];
+                global_number = static_cast<std::int32_t>(global.number);
+                builder.use_global(global_number.value());
+                type = global.type;
+                global.writes++;
+            }
+            if(!matches(operand_kind(operation.value()).first, type, right_register.type)){
+                throw error::make<error::TypeMismatch>(pos.clone());
+            }
+            auto ret = right_register.index;
+            if(operation == BinaryOperator::Add && global_number){
+                builder.emit(bytecode::Opcode::AddGlobal, ret, global_number.value(), right_register.index);
+                return {ret, std::move(type)};
+            }
+            if(operation != BinaryOperator::Assign){
+                auto current = builder.new_register();
+                if(global_number) builder.emit(bytecode::Opcode::LoadGlobal, current, global_number.value());
+                else builder.emit(bytecode::Opcode::Move, current, local_registers[binding.index].index);
+                builder.emit(opcode(operation.value()), ret, current, right_register.index);
+                if(may_trap(operation.value(), *right)) builder.set_position(pos.clone());
+            }
+            if(global_number) builder.emit(bytecode::Opcode::StoreGlobal, global_number.value(), ret);
+            else builder.emit(bytecode::Opcode::Move, local_registers[binding.index].index, ret);
+            return {ret, std::move(type)};
+        }
+        auto left_register = left->compile_bytecode(context, builder, local_registers);
+        auto right_register = right->compile_bytecode(context, builder, local_registers);
+        auto [kind, returns_boolean] = operand_kind(binary_operator);
+        if(!matches(kind, left_register.type, right_register.type)){
+            throw error::make<error::TypeMismatch>(pos.clone());
+        }
+        builder.emit(opcode(binary_operator), left_register.index, left_register.index, right_register.index);
+        if(may_trap(binary_operator, *right)) builder.set_position(pos.clone());
+        if(returns_boolean) left_register.type = std::make_shared<value::Boolean>();
+        return left_register;
+    }
+    //! 括弧でくくられた式をバイトコードにコンパイルする．
+    Register Group::compile_bytecode(Context &context, bytecode::Builder &builder, std::vector<Register> &local_registers){
+        return expression->compile_bytecode(context, builder, local_registers);
+    }
+    /**
+     * @brief 関数呼び出しをバイトコードにコンパイルする．
+     * @throw error::TypeMismatch 関数型がまだ無いので常に投げる
+     */
+    Register Invocation::compile_bytecode(Context &, bytecode::Builder &, std::vector<Register> &){
+        throw error::make<error::TypeMismatch>(function->pos.clone());
+    }
+
+    //! 識別子を評価する．
+    Evaluated Identifier::evaluate(Context &context, JIT &jit, std::vector<Evaluated> &local_variables, bool execute){
+        if(resolved.kind == Binding::Kind::Local) return local_variables[resolved.index];
+        auto &global = context.globals[resolved.index];
+        return {execute ? jit.load(context.global_variable_name(global.number), *global.type) : 0, global.type};
+    }
+    //! 整数リテラルを評価する．
+    Evaluated Integer::evaluate(Context &, JIT &, std::vector<Evaluated> &, bool){
+        return {value, std::make_shared<value::Integer>()};
+    }
+    /**
+     * @brief 単項演算を評価する．
+     * @throw error::TypeMismatch `!` のオペランドが真偽値でない，またはそれ以外のオペランドが整数でない
+     */
+    Evaluated UnaryOperation::evaluate(Context &context, JIT &jit, std::vector<Evaluated> &local_variables, bool execute){
+        auto ret = operand->evaluate(context, jit, local_variables, execute);
+        bool boolean_operator = unary_operator == UnaryOperator::LogicalNot;
+        if(boolean_operator ? !ret.type->is_boolean() : !ret.type->is_integer()){
+            throw error::make<error::TypeMismatch>(operand->pos.clone());
+        }
+        switch(unary_operator){
+            case UnaryOperator::Plus: break;
+            case UnaryOperator::Minus: ret.value = bytecode::apply(bytecode::Opcode::Minus, ret.value, 0); break;
+            case UnaryOperator::LogicalNot: ret.value = bytecode::apply(bytecode::Opcode::LogicalNot, ret.value, 0); break;
+            case UnaryOperator::BitNot: ret.value = bytecode::apply(bytecode::Opcode::BitNot, ret.value, 0);
+        }
+        return ret;
+    }
+    /**
+     * @brief 2 項演算を評価する．
+     *
+     * 意味は `compile_bytecode()` と同じで，演算そのものは `bytecode::apply()` に任せる．
+     * 短絡評価で評価されない右辺も，型を調べるために `execute = false` で辿る．
+     * @throw error::TypeMismatch オペランドの型が演算子に合わない
+     * @throw error::NotAssignable 代入演算子の左辺が識別子でない
+     * @throw error::DivisionByZero 0 で割った
+     */
+    Evaluated BinaryOperation::evaluate(Context &context, JIT &jit, std::vector<Evaluated> &local_variables, bool execute){
+        if(binary_operator == BinaryOperator::LogicalAnd || binary_operator == BinaryOperator::LogicalOr){
+            bool is_and = binary_operator == BinaryOperator::LogicalAnd;
+            auto left_value = left->evaluate(context, jit, local_variables, execute);
+            if(!left_value.type->is_boolean()) throw error::make<error::TypeMismatch>(left->pos.clone());
+            bool evaluates_right = execute && left_value.value == (is_and ? 1 : 0);
+            auto right_value = right->evaluate(context, jit, local_variables, evaluates_right);
+            if(!right_value.type->is_boolean()) throw error::make<error::TypeMismatch>(right->pos.clone());
+            return {evaluates_right ? right_value.value : left_value.value, std::make_shared<value::Boolean>()};
+        }
+        if(auto operation = assignment(binary_operator)){
+            auto name = left->identifier();
+            if(!name) throw error::make<error::NotAssignable>(left->pos.clone());
+            auto right_value = right->evaluate(context, jit, local_variables, execute);
+            auto binding = left->binding().value();
+            std::optional<std::string> global_name;
+            std::shared_ptr<value::Type> type;
+            if(binding.kind == Binding::Kind::Local){
+                type = local_variables[binding.index].type;
+            }else{
+                auto &global = context.globals[binding.index];
+                global_name = context.global_variable_name(global.number);
+                type = global.type;
+                global.writes++;
+            }
+            if(!matches(operand_kind(operation.value()).first, type, right_value.type)){
+                throw error::make<error::TypeMismatch>(pos.clone());
+            }
+            if(!execute) return {0, std::move(type)};
+            auto value = right_value.value;
+            if(operation != BinaryOperator::Assign){
+                auto current = global_name ? jit.load(global_name.value(), *type) : local_variables[binding.index].value;
+                value = bytecode::apply(opcode(operation.value()), current, value, &pos);
+            }
+            if(global_name) jit.store(global_name.value(), *type, value);
+            else local_variables[binding.index].value = value;
+            return {value, std::move(type)};
+        }
+        auto left_value = left->evaluate(context, jit, local_variables, execute);
+        auto right_value = right->evaluate(context, jit, local_variables, execute);
+        auto [kind, returns_boolean] = operand_kind(binary_operator);
+        if(!matches(kind, left_value.type, right_value.type)){
+            throw error::make<error::TypeMismatch>(pos.clone());
+        }
+        if(execute) left_value.value = bytecode::apply(opcode(binary_operator), left_value.value, right_value.value, &pos);
+        if(returns_boolean) left_value.type = std::make_shared<value::Boolean>();
+        return left_value;
+    }
+    //! 括弧でくくられた式を評価する．
+    Evaluated Group::evaluate(Context &context, JIT &jit, std::vector<Evaluated> &local_variables, bool execute){
+        return expression->evaluate(context, jit, local_variables, execute);
+    }
+    /**
+     * @brief 関数呼び出しを評価する．
+     * @throw error::TypeMismatch 関数型がまだ無いので常に投げる
+     */
+    Evaluated Invocation::evaluate(Context &, JIT &, std::vector<Evaluated> &, bool){
+        throw error::make<error::TypeMismatch>(function->pos.clone());
+    }
+
+    std::size_t Identifier::cost() const { return 1; }
+    std::size_t Integer::cost() const { return 1; }
+    std::size_t UnaryOperation::cost() const { return 1 + operand->cost(); }
+    std::size_t BinaryOperation::cost() const { return 1 + left->cost() + right->cost(); }
+    std::size_t Group::cost() const { return expression->cost(); }
+    std::size_t Invocation::cost() const {
+        std::size_t ret = 1 + function->cost();
+        for(auto &argument : arguments) ret += argument->cost();
+        return ret;
     }
-    value::Value UnaryOperation::compile(Context &, std::unordered_map<std::string, value::Value> &){}
-    value::Value BinaryOperation::compile(Context &, std::unordered_map<std::string, value::Value> &){}
-    value::Value Group::compile(Context &, std::unordered_map<std::string, value::Value> &){}
-    value::Value Invocation::compile(Context &, std::unordered_map<std::string, value::Value> &){}
 
     static constexpr std::string_view INDENT = "    ";
     void Identifier::debug_print(int depth) const {
@@ -7,8 +7,11 @@
 
 #include <optional>
 
+#include "bytecode.hpp"
 #include "context.hpp"
+#include "jit.hpp"
 #include "pos.hpp"
+#include "resolver.hpp"
 
 /**
  * @brief 式を定義する
@@ -63,6 +66,34 @@
  * @endcode
  */
 namespace expression {
+    /**
+     * @brief バイトコードのレジスタ番号と型の組（`value::Value` のバイトコード版）
+     */
+    struct Register {
+        std::int32_t index;
+        std::shared_ptr<value::Type> type;
+    };
+
+    /**
+     * @brief LLVM IR にコンパイルするときのローカル変数（`ssa::Builder` の変数の番号と型の組）
+     */
+    struct Variable {
+        unsigned index;
+        std::shared_ptr<value::Type> type;
+    };
+
+    /**
+     * @brief AST を直接評価した値と型の組（`value::Value` の評価版）
+     *
+     * 真偽値は 0 か 1 で表す．ローカル変数の値もこれで持つ．
+     */
+    struct Evaluated {
+        std::int32_t value;
+        std::shared_ptr<value::Type> type;
+    };
+
+    class BinaryOperation;
+
     /**
      * @brief 全ての式の基底クラス．
      */
@@ -70,12 +101,50 @@ namespace expression {
     public:
         //! ソースコード中の位置．
         pos::Range pos;
+        /**
+         * @brief 部分木の構造の番号（子の番号から作るハッシュ）．
+         *
+         * 位置を除いて同じ構造の部分木（括弧の有無は区別しない）には同じ番号が付く．
+         * 違う構造でも同じ番号になりうるので，使う側は `same_structure()` で確かめる．
+         * 副作用の無い式を同じ基本ブロックで再び計算しないために使う（`Context::find_available()`）．
+         */
+        const std::size_t structure;
+        Expression(std::size_t);
         virtual ~Expression();
         virtual std::optional<std::string> identifier();
+        virtual std::optional<Binding> binding() const;
+        virtual std::optional<std::int32_t> integer_literal() const;
+        /**
+         * @brief 式の中の識別子がどの変数を指すか決める（`Resolver`）．
+         * @throw error::UndefinedVariable 宣言されていない名前を参照している
+         */
+        virtual void resolve(Resolver &) = 0;
+        virtual bool is_speculatable() const = 0;
+        bool same_structure(const Expression &) const;
+        virtual const Expression &ungrouped() const;
+        //! 括弧を外した `other` と，この式の構造が同じか（`same_structure()` から呼ぶ）
+        virtual bool same_node(const Expression &other) const = 0;
+        virtual BinaryOperation *simple_assignment();
         /**
          * @todo 右辺値と左辺値で扱いが異なる．関数名も `compile` ではなくそれぞれ `rvalue` / `lvalue` にする．
          */
-        virtual value::Value compile(Context &, std::unordered_map<std::string, value::Value> &) = 0;
+        virtual value::Value compile(Context &, std::vector<Variable> &) = 0;
+        /**
+         * @brief バイトコードにコンパイルし，結果を入れたレジスタを返す．
+         *
+         * 返すレジスタは新しく確保した一時的なもので，呼び出し側が自由に使ってよい．
+         */
+        virtual Register compile_bytecode(Context &, bytecode::Builder &, std::vector<Register> &) = 0;
+        /**
+         * @brief コンパイルせずに直接評価する．
+         *
+         * ローカル変数の値は `Binding::index` の位置に持つ．
+         * 大域変数は `JIT` の上にあるものを直接読み書きする．
+         * `execute` が `false` なら型だけを調べ，変数の読み書きも演算もしない（短絡評価で評価されない右辺など）．
+         */
+        virtual Evaluated evaluate(Context &, JIT &, std::vector<Evaluated> &, bool) = 0;
+        //! 式の大きさ（ノード数）．直接評価するかコンパイルするかの判断に使う．
+        virtual std::size_t cost() const = 0;
         //! デバッグ出力用の関数．いずれ消す．
         virtual void debug_print(int = 0) const = 0;
     };
@@ -85,10 +154,19 @@ namespace expression {
      */
     class Identifier : public Expression {
         std::string name;
+        //! 名前解決の結果
+        Binding resolved;
     public:
         Identifier(std::string);
         std::optional<std::string> identifier() override;
-        value::Value compile(Context &, std::unordered_map<std::string, value::Value> &) override;
+        std::optional<Binding> binding() const override;
+        void resolve(Resolver &) override;
+        value::Value compile(Context &, std::vector<Variable> &) override;
+        Register compile_bytecode(Context &, bytecode::Builder &, std::vector<Register> &) override;
+        Evaluated evaluate(Context &, JIT &, std::vector<Evaluated> &, bool) override;
+        std::size_t cost() const override;
+        bool is_speculatable() const override;
+        bool same_node(const Expression &) const override;
         void debug_print(int) const override;
     };
 
@@ -99,7 +177,14 @@ namespace expression {
         std::int32_t value;
     public:
         Integer(std::int32_t);
-        value::Value compile(Context &, std::unordered_map<std::string, value::Value> &) override;
+        void resolve(Resolver &) override;
+        value::Value compile(Context &, std::vector<Variable> &) override;
+        Register compile_bytecode(Context &, bytecode::Builder &, std::vector<Register> &) override;
+        Evaluated evaluate(Context &, JIT &, std::vector<Evaluated> &, bool) override;
+        std::size_t cost() const override;
+        std::optional<std::int32_t> integer_literal() const override;
+        bool is_speculatable() const override;
+        bool same_node(const Expression &) const override;
         void debug_print(int) const override;
     };
 
@@ -123,9 +208,18 @@ namespace expression {
     class UnaryOperation : public Expression {
         UnaryOperator unary_operator;
         std::unique_ptr<Expression> operand;
+        //! `is_speculatable()` の結果（子の結果から作るので，式の深さに比例する時間はかからない）
+        bool pure;
+        value::Value compile_operation(Context &, std::vector<Variable> &);
     public:
         UnaryOperation(UnaryOperator, std::unique_ptr<Expression>);
-        value::Value compile(Context &, std::unordered_map<std::string, value::Value> &) override;
+        void resolve(Resolver &) override;
+        value::Value compile(Context &, std::vector<Variable> &) override;
+        Register compile_bytecode(Context &, bytecode::Builder &, std::vector<Register> &) override;
+        Evaluated evaluate(Context &, JIT &, std::vector<Evaluated> &, bool) override;
+        std::size_t cost() const override;
+        bool is_speculatable() const override;
+        bool same_node(const Expression &) const override;
         void debug_print(int) const override;
     };
 
@@ -199,9 +293,20 @@ namespace expression {
     class BinaryOperation : public Expression {
         BinaryOperator binary_operator;
         std::unique_ptr<Expression> left, right;
+        //! `is_speculatable()` の結果（子の結果から作るので，式の深さに比例する時間はかからない）
+        bool pure;
+        value::Value compile_operation(Context &, std::vector<Variable> &);
     public:
         BinaryOperation(BinaryOperator, std::unique_ptr<Expression>, std::unique_ptr<Expression>);
-        value::Value compile(Context &, std::unordered_map<std::string, value::Value> &) override;
+        void resolve(Resolver &) override;
+        value::Value compile(Context &, std::vector<Variable> &) override;
+        Register compile_bytecode(Context &, bytecode::Builder &, std::vector<Register> &) override;
+        Evaluated evaluate(Context &, JIT &, std::vector<Evaluated> &, bool) override;
+        std::size_t cost() const override;
+        bool is_speculatable() const override;
+        bool same_node(const Expression &) const override;
+        BinaryOperation *simple_assignment() override;
+        bool compile_select(Context &, std::vector<Variable> &, llvm::Value *, BinaryOperation *, llvm::MDNode *);
         void debug_print(int) const override;
     };
 
@@ -212,7 +317,16 @@ namespace expression {
         std::unique_ptr<Expression> expression;
     public:
         Group(std::unique_ptr<Expression>);
-        value::Value compile(Context &, std::unordered_map<std::string, value::Value> &) override;
+        void resolve(Resolver &) override;
+        value::Value compile(Context &, std::vector<Variable> &) override;
+        Register compile_bytecode(Context &, bytecode::Builder &, std::vector<Register> &) override;
+        Evaluated evaluate(Context &, JIT &, std::vector<Evaluated> &, bool) override;
+        std::size_t cost() const override;
+        std::optional<std::int32_t> integer_literal() const override;
+        bool is_speculatable() const override;
+        bool same_node(const Expression &) const override;
+        const Expression &ungrouped() const override;
+        BinaryOperation *simple_assignment() override;
         void debug_print(int) const override;
     };
 
@@ -224,7 +338,13 @@ namespace expression {
         std::vector<std::unique_ptr<Expression>> arguments;
     public:
         Invocation(std::unique_ptr<Expression>, std::vector<std::unique_ptr<Expression>>);
-        value::Value compile(Context &, std::unordered_map<std::string, value::Value> &) override;
+        void resolve(Resolver &) override;
+        value::Value compile(Context &, std::vector<Variable> &) override;
+        Register compile_bytecode(Context &, bytecode::Builder &, std::vector<Register> &) override;
+        Evaluated evaluate(Context &, JIT &, std::vector<Evaluated> &, bool) override;
+        std::size_t cost() const override;
+        bool is_speculatable() const override;
+        bool same_node(const Expression &) const override;
         void debug_print(int) const override;
     };
 }
@@ -0,0 +1,381 @@
+/**
+ * @file jit.cpp
+ */
+#include "jit.hpp"
+
+#include <cstring>
+#include <unordered_set>
+
+#include "memstats.hpp"
+#include "optimizer.hpp"
+#include "runtime.hpp"
+#include "trace.hpp"
+
+#include "llvm/ExecutionEngine/Orc/CompileUtils.h"
+#include "llvm/ExecutionEngine/Orc/RTDyldObjectLinkingLayer.h"
+#include "llvm/Linker/Linker.h"
+#include "llvm/Support/TargetSelect.h"
+
+static llvm::ExitOnError exit_on_error;
+
+/**
+ * @brief 何個のデータだけのモジュールを追加するごとに `JIT::compact()` するか
+ *
+ * 1 回の `compact()` は生きている大域変数の数に比例する時間がかかるので，ならせば文ごとの時間は一定になる．
+ */
+static constexpr std::size_t COMPACTION_INTERVAL = 256;
+
+/**
+ * @brief 最適化したモジュールを機械語に変換する区間を `--time-trace` に記録するコンパイラ．
+ *
+ * 区間の詳細は最適化した後のモジュールの統計（`trace::describe()`）．
+ */
+class TracedCompiler : public llvm::orc::TMOwningSimpleCompiler {
+public:
+    using TMOwningSimpleCompiler::TMOwningSimpleCompiler;
+    llvm::Expected<CompileResult> operator()(llvm::Module &module) override {
+        llvm::TimeTraceScope scope("Codegen", [&](){ return trace::describe(module); });
+        memstats::Scope phase(memstats::Phase::Codegen);
+        return TMOwningSimpleCompiler::operator()(module);
+    }
+};
+
+/**
+ * @brief コンストラクタ
+ *
+ * ネイティブのターゲットを初期化して `llvm::orc::LLJIT` を作り，IR を最適化する変換を登録する．
+ * オブジェクトファイルは `memory::MemoryManager` を使う `llvm::orc::RTDyldObjectLinkingLayer` で読み込む．
+ * 最適化と機械語への変換はそれぞれ `Optimize` `Codegen` の区間として `--time-trace` に記録される．
+ * 生成したコードが呼び出す実行時の関数（`runtime`）は，このプロセスの関数を絶対アドレスで登録する．
+ *
+ * `jit_events` で指定されたリスナーをオブジェクトファイルを読み込む層に登録する．
+ * jitdump は LLVM の `PerfJITEventListener` が `$JITDUMPDIR`（無ければ `$HOME`）の下の `.debug/jit` に書き出す．
+ * @param lazy 遅延モードにするか
+ * @param huge_pages JIT のメモリを大きなページで確保するか
+ * @param jit_events JIT でコンパイルした機械語を登録する先
+ * @param profiler 読み込んだ関数を知らせる `--profile` のプロファイラ（`nullptr` なら知らせない）
+ * @param remarks 最適化のリマークを渡す先（`nullptr` なら渡さない）．
+ * 遅延モードでは関数ごとに分割したモジュールが新しい `llvm::LLVMContext` に複製されるので，最適化する直前に設定し直す
+ */
+JIT::JIT(bool lazy, option::HugePages huge_pages, option::JITEvents jit_events, Profiler *profiler, Remarks *remarks): allocator(huge_pages), lazy_jit(nullptr), uncompacted_modules(0) {
+    llvm::InitializeNativeTarget();
+    llvm::InitializeNativeTargetAsmPrinter();
+    if(jit_events.perf_map){
+        std::error_code error_code;
+        perf_map_listener = std::make_unique<PerfMapListener>(error_code);
+        if(error_code) exit_on_error(llvm::errorCodeToError(error_code));
+        listeners.push_back(perf_map_listener.get());
+    }
+    if(jit_events.jitdump){
+        auto listener = llvm::JITEventListener::createPerfJITEventListener();
+        if(!listener) exit_on_error(llvm::make_error<llvm::StringError>("jitdump is not supported by this LLVM", llvm::inconvertibleErrorCode()));
+        listeners.push_back(listener);
+    }
+    if(jit_events.gdb) listeners.push_back(llvm::JITEventListener::createGDBRegistrationListener());
+    if(profiler) listeners.push_back(profiler);
+    auto create_object_linking_layer = [this](llvm::orc::ExecutionSession &session, const llvm::Triple &)
+        -> llvm::Expected<std::unique_ptr<llvm::orc::ObjectLayer>> {
+        auto layer = std::make_unique<llvm::orc::RTDyldObjectLinkingLayer>(
+            session,
+            [this](){ return std::make_unique<memory::MemoryManager>(allocator); }
+        );
+        for(auto listener : listeners) layer->registerJITEventListener(*listener);
+        return layer;
+    };
+    auto create_compiler = [](llvm::orc::JITTargetMachineBuilder target_machine_builder)
+        -> llvm::Expected<std::unique_ptr<llvm::orc::IRCompileLayer::IRCompiler>> {
+        auto target_machine = target_machine_builder.createTargetMachine();
+        if(!target_machine) return target_machine.takeError();
+        return std::make_unique<TracedCompiler>(std::move(target_machine.get()));
+    };
+    if(lazy){
+        auto lazy_jit_ptr = exit_on_error(
+            llvm::orc::LLLazyJITBuilder()
+                .setObjectLinkingLayerCreator(create_object_linking_layer)
+                .setCompileFunctionCreator(create_compiler)
+                .create()
+        );
+        lazy_jit = lazy_jit_ptr.get();
+        jit = std::move(lazy_jit_ptr);
+    }else{
+        jit = exit_on_error(
+            llvm::orc::LLJITBuilder()
+                .setObjectLinkingLayerCreator(create_object_linking_layer)
+                .setCompileFunctionCreator(create_compiler)
+                .create()
+        );
+    }
+    jit->getIRTransformLayer().setTransform(
+        [remarks](llvm::orc::ThreadSafeModule module, const llvm::orc::MaterializationResponsibility &){
+            module.withModuleDo([remarks](llvm::Module &module){
+                if(remarks) remarks->attach(module.getContext());
+                optimize(module);
+            });
+            return llvm::Expected<llvm::orc::ThreadSafeModule>(std::move(module));
+        }
+    );
+    exit_on_error(jit->getMainJITDylib().define(llvm::orc::absoluteSymbols({{
+        jit->mangleAndIntern(runtime::DIVISION_BY_ZERO),
+        llvm::JITEvaluatedSymbol(
+            llvm::pointerToJITTargetAddress(&runtime::division_by_zero),
+            llvm::JITSymbolFlags::Exported | llvm::JITSymbolFlags::Callable
+        )
+    }})));
+}
+
+/**
+ * @brief モジュールを追加する．
+ *
+ * 実際のコンパイルは，中の関数が初めて `run()` で参照されたときに行われる．
+ * 遅延モードでは関数ごとに分割され，呼び出された関数だけがコンパイルされる．
+ */
+void JIT::add(llvm::orc::ThreadSafeModule module){
+    add(std::move(module), jit->getMainJITDylib().getDefaultResourceTracker());
+}
+
+/**
+ * @brief モジュールを `tracker` で解放できるように追加する．
+ *
+ * `llvm::orc::LLLazyJIT::addLazyIRModule()` は `llvm::orc::ResourceTracker` を受け取らないので，
+ * 遅延モードではデータレイアウトを設定してから `llvm::orc::CompileOnDemandLayer` に直接追加する．
+ */
+void JIT::add(llvm::orc::ThreadSafeModule module, llvm::orc::ResourceTrackerSP tracker){
+    flush_data();
+    if(lazy_jit){
+        module.withModuleDo([this](llvm::Module &module){
+            if(module.getDataLayout().isDefault()) module.setDataLayout(jit->getDataLayout());
+        });
+        exit_on_error(lazy_jit->getCompileOnDemandLayer().add(std::move(tracker), std::move(module)));
+    }else{
+        exit_on_error(jit->addIRModule(std::move(tracker), std::move(module)));
+    }
+}
+
+/**
+ * @brief 文ごとにコンパイルしたモジュール（`Sentence::compile_module()`）を追加する．
+ *
+ * 関数を持たないデータだけのモジュールは `data_module` に結合しておき，
+ * 連続する宣言がいくつあっても 1 つのモジュールとして追加されるようにする．
+ * ただし `Context::context` が取り替えられていたら，結合できないので先に `flush_data()` する．
+ *
+ * 関数を持つモジュールは，大域変数の定義をデータだけのモジュールに移して外部の宣言に置き換えてから，
+ * 専用の `llvm::orc::ResourceTracker` で追加する．関数を実行し終えたら `run()` がモジュールごと解放する．
+ * 大域変数の `DIGlobalVariable`（`-g`）は元のモジュールの宣言に残るので，関数の DWARF からその番地を参照できる．
+ * @param context `module` を作った `Context::context`
+ */
+void JIT::add(std::unique_ptr<llvm::Module> module, const llvm::orc::ThreadSafeContext &context){
+    memstats::Scope phase(memstats::Phase::JIT);
+    if(!module->functions().empty()){
+        auto data = std::make_unique<llvm::Module>(module->getName().str() + ".data", module->getContext());
+        data->setDataLayout(module->getDataLayout());
+        data->setTargetTriple(module->getTargetTriple());
+        for(auto &global : module->globals()){
+            if(global.isDeclaration()) continue;
+            auto definition = new llvm::GlobalVariable(
+                *data,
+                global.getValueType(),
+                global.isConstant(),
+                global.getLinkage(),
+                global.getInitializer(),
+                global.getName()
+            );
+            definition->setAlignment(global.getAlign());
+            global.setInitializer(nullptr);
+            global.setLinkage(llvm::GlobalValue::ExternalLinkage);
+        }
+        if(!data->global_empty()) add(std::move(data), context);
+        auto tracker = jit->getMainJITDylib().createResourceTracker();
+        for(auto &function : module->functions()){
+            if(!function.isDeclaration()) function_trackers.insert_or_assign(function.getName().str(), tracker);
+        }
+        add(llvm::orc::ThreadSafeModule(std::move(module), context), std::move(tracker));
+        return;
+    }
+    if(data_module && data_context.getContext() != context.getContext()) flush_data();
+    if(!data_module){
+        data_module = std::move(module);
+        data_context = context;
+        return;
+    }
+    if(llvm::Linker::linkModules(*data_module, std::move(module))){
+        exit_on_error(llvm::make_error<llvm::StringError>("cannot link a data module", llvm::inconvertibleErrorCode()));
+    }
+}
+
+/**
+ * @brief 結合しておいたデータだけのモジュールがあれば追加する．
+ *
+ * 中の大域変数がすべて `release_global()` されたら解放できるように，専用の `llvm::orc::ResourceTracker` を使う．
+ */
+void JIT::flush_data(){
+    if(!data_module) return;
+    auto data = std::make_shared<DataModule>(DataModule{jit->getMainJITDylib().createResourceTracker(), 0});
+    auto &data_layout = data_module->getDataLayout();
+    for(auto &global : data_module->globals()){
+        if(global.isDeclaration()) continue;
+        data_modules.insert_or_assign(
+            global.getName().str(),
+            ModuleGlobal{data, data_layout.getTypeStoreSize(global.getValueType()).getFixedSize()}
+        );
+        data->live_globals++;
+    }
+    uncompacted_modules++;
+    add(llvm::orc::ThreadSafeModule(std::move(data_module), std::move(data_context)), data->tracker);
+}
+
+/**
+ * @brief 引数も戻り値も無い関数を実行する．
+ *
+ * 文ごとのモジュールの関数なら，実行し終えた時点でモジュールの機械語と IR を解放する．
+ * データだけのモジュールが `COMPACTION_INTERVAL` 個溜まっていたら `compact()` する．
+ *
+ * `--time-trace` には，関数を探す（まだなら最適化・コンパイル・リンクする）`Materialize`，
+ * 実行する `Execute`，解放する `Release` の区間を記録する．
+ * @param function_name 関数名（`Context::function_name()`）
+ * @throw error::DivisionByZero 0 で割った（`runtime::call()`）
+ */
+void JIT::run(const std::string &function_name){
+    flush_data();
+    void (*function)();
+    {
+        llvm::TimeTraceScope scope("Materialize", function_name);
+        memstats::Scope phase(memstats::Phase::JIT);
+        auto symbol = exit_on_error(jit->lookup(function_name));
+        function = reinterpret_cast<void (*)()>(symbol.getAddress());
+    }
+    {
+        llvm::TimeTraceScope scope("Execute", function_name);
+        memstats::Scope phase(memstats::Phase::Execute);
+        runtime::call(function);
+    }
+    auto tracker = function_trackers.find(function_name);
+    if(tracker == function_trackers.end()) return;
+    {
+        llvm::TimeTraceScope scope("Release", function_name);
+        memstats::Scope phase(memstats::Phase::JIT);
+        exit_on_error(tracker->second->remove());
+    }
+    function_trackers.erase(tracker);
+    if(uncompacted_modules >= COMPACTION_INTERVAL){
+        llvm::TimeTraceScope scope("Compact");
+        memstats::Scope phase(memstats::Phase::JIT);
+        compact();
+    }
+}
+
+/**
+ * @brief データだけのモジュールで定義した大域変数を，すべて `global_storage` に移してモジュールを解放する．
+ *
+ * 大域変数の名前は変わらないので，`Context` の側で書き換えるものは無い．
+ * 移す前にコンパイル済みで，まだ実行していない関数があってはならない（古いアドレスを指したままになる）．
+ * `run()` の最後では，文ごとのモジュールの関数はどれもまだコンパイルされていないか，実行して解放済みである．
+ */
+void JIT::compact(){
+    uncompacted_modules = 0;
+    if(data_modules.empty()) return;
+    llvm::orc::SymbolMap symbols;
+    std::unordered_set<std::shared_ptr<DataModule>> modules;
+    for(auto &[name, global] : data_modules){
+        auto address = allocate_storage();
+        std::memcpy(address, global_address(name), global.size);
+        symbols.try_emplace(
+            jit->mangleAndIntern(name),
+            llvm::JITEvaluatedSymbol(llvm::pointerToJITTargetAddress(address), llvm::JITSymbolFlags::Exported)
+        );
+        global_addresses.insert_or_assign(name, address);
+        defined_globals.emplace(name, address);
+        modules.insert(global.module);
+    }
+    data_modules.clear();
+    for(auto &module : modules) exit_on_error(module->tracker->remove());
+    exit_on_error(jit->getMainJITDylib().define(llvm::orc::absoluteSymbols(std::move(symbols))));
+}
+
+/**
+ * @brief 大域変数のアドレスを返す．
+ *
+ * モジュールで定義された大域変数は，そのモジュールが実行済みでなければならない．
+ */
+void *JIT::global_address(const std::string &name){
+    auto cached = global_addresses.find(name);
+    if(cached != global_addresses.end()) return cached->second;
+    flush_data();
+    auto symbol = exit_on_error(jit->lookup(name));
+    auto address = llvm::jitTargetAddressToPointer<void *>(symbol.getAddress());
+    global_addresses.emplace(name, address);
+    return address;
+}
+
+//! `global_storage` から大域変数 1 つ分の領域を 0 で初期化して確保する（解放されたものがあれば再利用する）．
+std::int32_t *JIT::allocate_storage(){
+    if(free_storage.empty()) return &global_storage.emplace_back(0);
+    auto address = free_storage.back();
+    free_storage.pop_back();
+    *address = 0;
+    return address;
+}
+
+/**
+ * @brief モジュールを作らずに大域変数を 0 で初期化して確保し，`name` として JIT に登録する．
+ *
+ * 以降に追加されるモジュールは `name` を外部の大域変数として参照できる．
+ * 整数も真偽値も 4 バイトの領域に置く（真偽値は LLVM の `i1` と同じく先頭の 1 バイトを使う）．
+ */
+void JIT::define_global(const std::string &name){
+    auto address = allocate_storage();
+    exit_on_error(jit->getMainJITDylib().define(llvm::orc::absoluteSymbols({{
+        jit->mangleAndIntern(name),
+        llvm::JITEvaluatedSymbol(llvm::pointerToJITTargetAddress(address), llvm::JITSymbolFlags::Exported)
+    }})));
+    global_addresses.emplace(name, address);
+    defined_globals.emplace(name, address);
+}
+
+/**
+ * @brief 大域変数の値を読む．
+ *
+ * 真偽値は LLVM が `i1` をメモリに置くときと同じく 1 バイトとして読む．
+ */
+std::int32_t JIT::load(const std::string &name, const value::Type &type){
+    auto address = global_address(name);
+    if(type.is_boolean()) return *static_cast<std::uint8_t *>(address);
+    return *static_cast<std::int32_t *>(address);
+}
+
+/**
+ * @brief 大域変数に値を書き込む．
+ */
+void JIT::store(const std::string &name, const value::Type &type, std::int32_t value){
+    auto address = global_address(name);
+    if(type.is_boolean()) *static_cast<std::uint8_t *>(address) = static_cast<std::uint8_t>(value);
+    else *static_cast<std::int32_t *>(address) = value;
+}
+
+/**
+ * @brief もう参照されない大域変数を解放する．
+ *
+ * `define_global()` で確保したものは JIT から名前を消して領域を再利用する．
+ * モジュールで定義したものは，同じデータだけのモジュールの大域変数がすべて解放されたらモジュールごと解放する．
+ * 呼び出す側は，`name` を参照する関数がもう実行されないことを保証しなければならない（`Context::retired_globals`）．
+ */
+void JIT::release_global(const std::string &name){
+    global_addresses.erase(name);
+    if(data_module){
+        auto global = data_module->getNamedGlobal(name);
+        if(global && !global->isDeclaration()){
+            global->eraseFromParent();
+            return;
+        }
+    }
+    if(auto defined = defined_globals.find(name); defined != defined_globals.end()){
+        exit_on_error(jit->getMainJITDylib().remove({jit->mangleAndIntern(name)}));
+        free_storage.push_back(defined->second);
+        defined_globals.erase(defined);
+        return;
+    }
+    auto data = data_modules.find(name);
+    if(data == data_modules.end()) return;
+    auto module = std::move(data->second.module);
+    data_modules.erase(data);
+    if(--module->live_globals == 0) exit_on_error(module->tracker->remove());
+}
@@ -0,0 +1,105 @@
+/**
+ * @file jit.hpp
+ * @brief コンパイルしたモジュールを JIT で実行する
+ */
+#ifndef JIT_HPP
+#define JIT_HPP
+
+#include <deque>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "memory.hpp"
+#include "perfmap.hpp"
+#include "profiler.hpp"
+#include "remarks.hpp"
+#include "value.hpp"
+
+#include "llvm/ExecutionEngine/Orc/LLJIT.h"
+
+/**
+ * @brief `llvm::orc::LLJIT` をラップしたクラス．
+ *
+ * 追加されたモジュールは最適化（`optimize()`）されてから機械語に変換される．
+ * 各モジュールの大域変数 `g<N>` は同じ `JITDylib` の中で解決されるので，モジュールをまたいで参照できる．
+ *
+ * 遅延モードでは `llvm::orc::LLLazyJIT` を使い，モジュール中の関数は初めて呼び出されたときに
+ * 1 つずつ最適化・コンパイルされる（`llvm::orc::CompileOnDemandLayer`）．
+ *
+ * 関数を持たずに大域変数だけを定義するモジュールは，すぐには追加せずに 1 つのモジュールへ結合しておき，
+ * 関数を持つモジュールを追加する前や実行・読み書きの前にまとめて追加する（`flush_data()`）．
+ *
+ * 大域変数はモジュールで定義されるほか，`define_global()` で JIT の外に確保することもできる．
+ * どちらも `load()` `store()` で直接読み書きでき，AST を直接評価する文とコンパイルした文が同じ値を共有する．
+ *
+ * 文ごとのモジュールは `llvm::orc::ResourceTracker` で管理する．文の関数は一度しか実行しないので，
+ * `run()` が終わればその機械語を解放する．そのため関数を持つモジュールの大域変数の定義は，
+ * 追加するときにデータだけのモジュールへ移しておく．宣言し直されて隠れた大域変数は
+ * `release_global()` で解放し，同じデータのモジュールの大域変数がすべて解放されたらそのモジュールも解放する．
+ *
+ * 長く続く対話モードでは小さなデータだけのモジュールが文の数だけ溜まるので，一定数ごとに
+ * 生きている大域変数を `global_storage` へ移してモジュールを解放する（`compact()`）．
+ *
+ * 機械語とデータは `memory::SlabAllocator` の大きなスラブからモジュールをまたいで切り出す．
+ *
+ * `--jit-events` なら，読み込んだオブジェクトファイルを perf や GDB に登録する（`llvm::JITEventListener`）．
+ * `--profile` なら，同じく `Profiler` に関数のアドレスの範囲と行番号表を知らせる．
+ * `--remarks` なら，最適化するモジュールのリマークを `Remarks` に渡す．
+ */
+class JIT {
+    //! `jit` が作るメモリマネージャが参照するので，`jit` より先に作り後に破棄する
+    memory::SlabAllocator allocator;
+    //! `--jit-events=perf-map` のリスナー（`jit` より先に作り後に破棄する）
+    std::unique_ptr<PerfMapListener> perf_map_listener;
+    //! オブジェクトファイルを読み込むたびに知らせるリスナー
+    std::vector<llvm::JITEventListener *> listeners;
+    std::unique_ptr<llvm::orc::LLJIT> jit;
+    //! 遅延モードなら `jit` と同じものを指す．そうでなければ `nullptr`
+    llvm::orc::LLLazyJIT *lazy_jit;
+    //! `define_global()` で確保した大域変数の実体（`std::deque` なのでアドレスは変わらない）
+    std::deque<std::int32_t> global_storage;
+    //! 大域変数のアドレスのキャッシュ
+    std::unordered_map<std::string, void *> global_addresses;
+    //! まだ追加していない，データだけのモジュールを結合したもの
+    std::unique_ptr<llvm::Module> data_module;
+    llvm::orc::ThreadSafeContext data_context;
+    //! 追加したデータだけのモジュールと，その中でまだ解放していない大域変数の数
+    struct DataModule {
+        llvm::orc::ResourceTrackerSP tracker;
+        std::size_t live_globals;
+    };
+    //! データだけのモジュールで定義した大域変数
+    struct ModuleGlobal {
+        std::shared_ptr<DataModule> module;
+        //! 大きさ（バイト数）
+        std::size_t size;
+    };
+    //! 大域変数の名前から，それを定義したデータだけのモジュール
+    std::unordered_map<std::string, ModuleGlobal> data_modules;
+    //! 前回の `compact()` から追加したデータだけのモジュールの数
+    std::size_t uncompacted_modules;
+    //! まだ実行していない文の関数の名前から，その関数のモジュール
+    std::unordered_map<std::string, llvm::orc::ResourceTrackerSP> function_trackers;
+    //! `define_global()` で確保した大域変数の名前
+    std::unordered_map<std::string, std::int32_t *> defined_globals;
+    //! 解放されて再利用を待つ `global_storage` の要素
+    std::vector<std::int32_t *> free_storage;
+    void *global_address(const std::string &);
+    std::int32_t *allocate_storage();
+    void flush_data();
+    void compact();
+    void add(llvm::orc::ThreadSafeModule, llvm::orc::ResourceTrackerSP);
+public:
+    JIT(bool = false, option::HugePages = option::HugePages::Off, option::JITEvents = {}, Profiler * = nullptr, Remarks * = nullptr);
+    void add(llvm::orc::ThreadSafeModule);
+    void add(std::unique_ptr<llvm::Module>, const llvm::orc::ThreadSafeContext &);
+    void run(const std::string &);
+    void define_global(const std::string &);
+    std::int32_t load(const std::string &, const value::Type &);
+    void store(const std::string &, const value::Type &, std::int32_t);
+    void release_global(const std::string &);
+};
+
+#endif
@@ -3,6 +3,9 @@
  */
 #include "lexer.hpp"
 #include "error.hpp"
+#include "memstats.hpp"
+
+#include "llvm/Support/TimeProfiler.h"
 
 /**
  * @brief 標準入力から読む．
@@ -35,6 +38,7 @@ std::unique_ptr<token::Token> &Lexer::peek(){
     while(tokens.empty()){
         if(source){
             // まだ EOF に達していない
+            memstats::Scope phase(memstats::Phase::Lex);
             // 次の行が何行目か
             auto line_num = log.size();
             // log に空の std::string を追加し，1 行読んで格納
@@ -42,6 +46,7 @@ std::unique_ptr<token::Token> &Lexer::peek(){
             if(prompt) std::cout << "> ";
             std::getline(source, log.back());
             // 字句解析を行う
+            llvm::TimeTraceScope scope("Lex", [&](){ return std::to_string(line_num + 1); });
             inner.run(line_num, log.back(), tokens);
         }else{
             // EOF に達した
@@ -5,22 +5,318 @@
 #include "parser.hpp"
 #include "error.hpp"
 #include "context.hpp"
+#include "jit.hpp"
+#include "vm.hpp"
+#include "emit.hpp"
+#include "option.hpp"
+#include "trace.hpp"
+#include "memstats.hpp"
+
+#include "llvm/Linker/Linker.h"
+
+/**
+ * @brief `--adaptive` で直接評価する文の大きさ（`Sentence::cost()`）の上限
+ *
+ * これより大きい文は，コンパイルの時間をかけても速く実行したほうが得だと考える．
+ */
+static constexpr std::size_t EVALUATION_COST_LIMIT = 256;
+
+/**
+ * @brief 文ごとにモジュールを作って実行するとき，何個のモジュールごとに `llvm::LLVMContext` を取り替えるか
+ *
+ * 長く続く対話モードで，一意化された定数などが溜まり続けないようにする（`Context::context_lifetime`）．
+ */
+static constexpr unsigned CONTEXT_LIFETIME = 1024;
+
+/**
+ * @brief 実行し終えた文で宣言し直されて隠れた大域変数を解放する．
+ *
+ * 文は読んだ順に一度だけ実行されるので，隠れた大域変数を参照する文はもう残っていない．
+ */
+static void release_retired_globals(Context &context, JIT &jit){
+    for(auto number : context.retired_globals) jit.release_global(context.global_variable_name(number));
+    context.retired_globals.clear();
+}
+
+/**
+ * @brief オプションに応じて `Context` に結び付ける計測・最適化の道具
+ *
+ * `Context` が指すので，`Context` と同じかより長く生きるようにする．
+ */
+struct Tools {
+    Counters counters;
+    Profiler profiler;
+    pgo::Instrumentation instrumentation;
+    pgo::Profile profile;
+    Remarks remarks;
+    Tools(const Lexer &lexer, const option::Option &option): remarks(option.remarks, lexer.get_log()) {}
+};
+
+/**
+ * @brief `option` に従って `context` を設定し，必要な `tools` を結び付ける．
+ *
+ * `--remarks-yaml` のファイルを開き，`--profile` ならサンプリングを始める．
+ * @retval false ファイルを開けなかった，またはプロファイラを始められなかった
+ */
+static bool configure(Context &context, Tools &tools, const Lexer &lexer, const option::Option &option){
+    context.branchless = option.branchless;
+    context.debug_info = option.debug_info || option.profile || option.remarks.any();
+    context.source_file = option.input.value_or("<stdin>");
+    context.source = &lexer.get_log();
+    if(option.counters) context.counters = &tools.counters;
+    if(option.pgo_gen) context.pgo_instrumentation = &tools.instrumentation;
+    if(option.pgo_use && tools.profile.read(option.pgo_use.value())) context.pgo_profile = &tools.profile;
+    if(option.remarks.any()) context.remarks = &tools.remarks;
+    if(option.remarks_yaml && !tools.remarks.open_yaml(option.remarks_yaml.value())) return false;
+    if(option.profile && !tools.profiler.start()) return false;
+    return true;
+}
+
+/**
+ * @brief `option` に従って `JIT` を作る．
+ *
+ * 以降に文ごとに作るモジュールのため，`context` の `llvm::LLVMContext` を取り替える間隔と関数名も `JIT` に合わせる．
+ */
+static JIT make_jit(Context &context, Tools &tools, bool lazy, const option::Option &option){
+    context.context_lifetime = CONTEXT_LIFETIME;
+    context.source_names = option.jit_events.any() || option.profile;
+    return JIT(lazy, option.huge_pages, option.jit_events, option.profile ? &tools.profiler : nullptr, context.remarks);
+}
 
 /**
- * @todo コマンドライン引数を読む
+ * @brief 実行し終えたときに，`--counters` の結果を報告し，`--profile` `--pgo-gen` の結果を書き出す．
+ * @retval false 結果を書き出せなかった
  */
-int main(){
+static bool finish(Tools &tools, const Lexer &lexer, const option::Option &option){
+    if(option.counters) tools.counters.report(lexer.get_log());
+    bool ok = !option.profile || tools.profiler.write(option.profile.value());
+    if(option.pgo_gen && !tools.instrumentation.write(option.pgo_gen.value())) ok = false;
+    return ok;
+}
+
+/**
+ * @brief 次の文を構文解析する．
+ *
+ * `--time-trace` には字句解析を含めて `Parse` の区間として記録する．対話モードでは入力を待つ時間も含む．
+ * @retval nullptr EOF に達した
+ */
+static std::unique_ptr<sentence::Sentence> parse(Lexer &lexer){
+    llvm::TimeTraceScope scope("Parse");
+    memstats::Scope phase(memstats::Phase::Parse);
+    return parse_sentence(lexer);
+}
+
+//! 文の名前解決をする（`--time-trace` の `Resolve` の区間）．
+static void resolve(sentence::Sentence &sentence, Resolver &resolver){
+    llvm::TimeTraceScope scope("Resolve", [&](){ return trace::describe(sentence.pos); });
+    memstats::Scope phase(memstats::Phase::Resolve);
+    sentence.resolve(resolver);
+}
+
+/**
+ * @brief 標準入力から 1 文ずつ読み，その都度コンパイルして実行する．
+ *
+ * `option.adaptive` なら，繰り返しを含まず小さい文は `Sentence::evaluate()` で直接評価する．
+ * 大域変数は `JIT` の上で共有されるので，どちらで実行した文の結果も互いに見える．
+ * 実行し終えた文のモジュールと，宣言し直されて隠れた大域変数は解放するので，長く続けてもメモリは増え続けない．
+ *
+ * `--time-trace` には文ごとに `Sentence` の区間を記録し，その中に各段階の区間を入れ子にする．
+ * `--counters` なら，入力が終わったときに最も多く実行された行を報告する．
+ * `--profile` なら，入力が終わったときにサンプリングの結果を書き出す．
+ * `--pgo-gen` なら，入力が終わったときに分岐の回数を書き出す．
+ * `--remarks` なら，各文を最適化するときのリマークをその場で報告する．
+ * @retval false プロファイラを始められなかった，または結果を書き出せなかった
+ */
+static bool run_interactive(const option::Option &option){
     Lexer lexer;
+    Tools tools(lexer, option);
     Context context;
+    Resolver resolver;
+    if(!configure(context, tools, lexer, option)) return false;
     try{
-        while(true){
-            auto sentence = parse_sentence(lexer);
-            if(!sentence) break;
-            sentence->debug_print();
-            auto module = sentence->compile(context);
-            module.withModuleDo([](const llvm::Module &mod){ mod.print(llvm::errs(), nullptr); });
+        if(option.backend == option::Backend::VM){
+            VM vm;
+            while(auto sentence = parse(lexer)){
+                llvm::TimeTraceScope scope("Sentence", [&](){ return trace::describe(sentence->pos); });
+                resolve(*sentence, resolver);
+                {
+                    llvm::TimeTraceScope scope("DebugPrint");
+                    sentence->debug_print();
+                }
+                bytecode::Builder builder;
+                {
+                    llvm::TimeTraceScope scope("Compile");
+                    memstats::Scope phase(memstats::Phase::Compile);
+                    sentence->compile_bytecode(context, builder);
+                }
+                auto code = builder.finish();
+                {
+                    llvm::TimeTraceScope scope("DebugPrint");
+                    code.print(std::cerr);
+                }
+                llvm::TimeTraceScope execute_scope("Execute");
+                memstats::Scope execute_phase(memstats::Phase::Execute);
+                vm.run(code);
+            }
+            return true;
+        }
+        auto jit = make_jit(context, tools, false, option);
+        while(auto sentence = parse(lexer)){
+            llvm::TimeTraceScope scope("Sentence", [&](){ return trace::describe(sentence->pos); });
+            resolve(*sentence, resolver);
+            {
+                llvm::TimeTraceScope scope("DebugPrint");
+                sentence->debug_print();
+            }
+            auto cost = sentence->cost();
+            if(option.adaptive && cost && cost.value() <= EVALUATION_COST_LIMIT){
+                llvm::TimeTraceScope scope("Evaluate");
+                memstats::Scope phase(memstats::Phase::Execute);
+                sentence->evaluate(context, jit);
+            }else{
+                std::unique_ptr<llvm::Module> module;
+                {
+                    llvm::TimeTraceScope scope("Compile");
+                    memstats::Scope phase(memstats::Phase::Compile);
+                    module = sentence->compile_module(context);
+                }
+                {
+                    llvm::TimeTraceScope scope("DebugPrint");
+                    module->print(llvm::errs(), nullptr);
+                }
+                bool executable = module->getFunction(context.function_name());
+                jit.add(std::move(module), context.context);
+                if(executable) jit.run(context.function_name());
+            }
+            release_retired_globals(context, jit);
         }
     }catch(std::unique_ptr<error::Error> &error){
         error->eprint(lexer.get_log());
     }
+    return finish(tools, lexer, option);
+}
+
+/**
+ * @brief ファイルを最後まで読んでから実行する．
+ *
+ * 通常はプログラム全体を 1 つのモジュールにコンパイルする（`Sentence::compile_program()`）．
+ * `option.lazy` なら文ごとのモジュールを遅延モードの `JIT` に追加し，`f1` … `fN` のうち作られたものを順に呼び出す．
+ * このとき各文は呼び出される直前に初めて最適化・コンパイルされる．
+ * `--backend=vm` ならプログラム全体を 1 つのバイトコードにコンパイルして `VM` で実行する．
+ * `--counters` なら，実行し終えたときに最も多く実行された行を報告する．
+ * `--profile` なら，読み込みから実行し終えるまでをサンプリングし，結果を書き出す．
+ * `--pgo-gen` なら，実行し終えたときに分岐の回数を書き出す．
+ * `--remarks` なら，最適化するときのリマークを報告する．
+ * @retval false 構文エラー等で実行できなかった，またはプロファイルを書き出せなかった
+ */
+static bool run_file(std::ifstream &file, const option::Option &option){
+    Lexer lexer(file);
+    Tools tools(lexer, option);
+    Context context;
+    Resolver resolver;
+    if(!configure(context, tools, lexer, option)) return false;
+    try{
+        std::vector<std::unique_ptr<sentence::Sentence>> sentences;
+        while(auto sentence = parse(lexer)){
+            resolve(*sentence, resolver);
+            sentences.push_back(std::move(sentence));
+        }
+        if(option.backend == option::Backend::VM){
+            bytecode::Builder builder;
+            for(auto &sentence : sentences){
+                llvm::TimeTraceScope scope("Compile", [&](){ return trace::describe(sentence->pos); });
+                memstats::Scope phase(memstats::Phase::Compile);
+                sentence->compile_bytecode(context, builder);
+            }
+            VM vm;
+            llvm::TimeTraceScope scope("Execute");
+            memstats::Scope phase(memstats::Phase::Execute);
+            vm.run(builder.finish());
+        }else if(option.lazy){
+            auto jit = make_jit(context, tools, true, option);
+            std::vector<std::string> functions;
+            for(auto &sentence : sentences){
+                llvm::TimeTraceScope scope("Compile", [&](){ return trace::describe(sentence->pos); });
+                memstats::Scope phase(memstats::Phase::Compile);
+                auto module = sentence->compile_module(context);
+                if(module->getFunction(context.function_name())) functions.push_back(context.function_name());
+                jit.add(std::move(module), context.context);
+            }
+            for(auto &function : functions){
+                jit.run(function);
+            }
+        }else{
+            llvm::orc::ThreadSafeModule module;
+            {
+                llvm::TimeTraceScope scope("Compile");
+                memstats::Scope phase(memstats::Phase::Compile);
+                module = sentence::Sentence::compile_program(context, sentences);
+            }
+            auto jit = make_jit(context, tools, false, option);
+            jit.add(std::move(module));
+            jit.run(context.function_name(0));
+        }
+        return finish(tools, lexer, option);
+    }catch(std::unique_ptr<error::Error> &error){
+        error->eprint(lexer.get_log());
+        return false;
+    }
+}
+
+/**
+ * @brief ファイルを文ごとにコンパイルし，結合して `option.emit` の形式で出力する．
+ *
+ * 各文は `Sentence::compile_module()` で `f<N>` を持つモジュールになり，
+ * 実行ファイルでは `add_entry_point()` が追加する `main` がそれらを順に呼び出す．
+ * `--pgo-use` なら，JIT で実行したときのプロファイルを使って最適化する．
+ * `--remarks` なら，最適化するときのリマークを報告する．
+ * @retval false 構文エラーや出力の失敗があった
+ */
+static bool compile_file(std::ifstream &file, const option::Option &option){
+    Lexer lexer(file);
+    Tools tools(lexer, option);
+    Context context;
+    Resolver resolver;
+    if(!configure(context, tools, lexer, option)) return false;
+    try{
+        llvm::Module program(option.input.value(), *context.context.getContext());
+        llvm::Linker linker(program);
+        while(auto sentence = parse(lexer)){
+            resolve(*sentence, resolver);
+            llvm::TimeTraceScope scope("Compile", [&](){ return trace::describe(sentence->pos); });
+            memstats::Scope phase(memstats::Phase::Compile);
+            if(linker.linkInModule(sentence->compile_module(context))) return false;
+        }
+        add_entry_point(context, program);
+        return emit(program, option);
+    }catch(std::unique_ptr<error::Error> &error){
+        error->eprint(lexer.get_log());
+        return false;
+    }
+}
+
+int main(int argc, char *argv[]){
+    auto option = option::parse(argc, argv);
+    if(!option) return 1;
+    if(!option->input && option->emit){
+        std::cerr << "--emit requires an input file" << std::endl;
+        return 1;
+    }
+    std::ifstream file;
+    if(option->input){
+        file.open(option->input.value());
+        if(!file){
+            std::cerr << "cannot open " << option->input.value() << std::endl;
+            return 1;
+        }
+    }
+    if(option->time_trace) trace::start();
+    if(option->mem_stats) memstats::start();
+    bool ok = true;
+    if(!option->input) ok = run_interactive(option.value());
+    else if(option->emit) ok = compile_file(file, option.value());
+    else ok = run_file(file, option.value());
+    if(option->mem_stats) memstats::report();
+    if(option->time_trace && !trace::finish(option->time_trace.value())) ok = false;
+    return ok ? 0 : 1;
 }
@@ -0,0 +1,215 @@
+/**
+ * @file memory.cpp
+ */
+#include "memory.hpp"
+#include "memstats.hpp"
+
+#include <algorithm>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "llvm/Support/ErrorHandling.h"
+#include "llvm/Support/Memory.h"
+
+namespace memory {
+    /**
+     * @brief スラブの大きさ（x86-64 の大きなページ 1 枚分）
+     *
+     * これより大きなセクションを持つモジュールには，それが収まる大きさのスラブを確保する．
+     */
+    static constexpr std::size_t SLAB_SIZE = std::size_t(2) << 20;
+    /**
+     * @brief `reserveAllocationSpace()` で見積もりに足す余裕
+     *
+     * GOT のように見積もりに含まれないセクションや，セクションごとの境界合わせの分．
+     */
+    static constexpr std::size_t RESERVE_SLACK = 4096;
+
+    static std::size_t align_up(std::size_t value, std::size_t alignment){
+        return (value + alignment - 1) / alignment * alignment;
+    }
+
+    /**
+     * @brief コンストラクタ
+     * @param huge_pages スラブを大きなページで確保するか
+     */
+    SlabAllocator::SlabAllocator(option::HugePages huge_pages): current(nullptr), huge_pages(huge_pages) {}
+
+    SlabAllocator::~SlabAllocator(){
+        for(auto &slab : slabs) unmap(slab.get());
+    }
+
+    /**
+     * @brief `memfd` を書き込み用と実行用に隣り合わせで割り当てる．
+     *
+     * 先に 2 つ分の領域を `PROT_NONE` で予約し，その中に `MAP_FIXED` で `fd` を 2 回割り当てる．
+     * 予約の先頭はスラブの大きさに揃える（大きなページのため）．
+     * @return 書き込み用の側の先頭（実行用の側はその `size` バイト後）
+     * @retval nullptr 割り当てられなかった
+     */
+    static std::uint8_t *map_views(int fd, std::size_t size){
+        auto reservation = static_cast<std::uint8_t *>(mmap(nullptr, 2 * size + SLAB_SIZE, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0));
+        if(reservation == MAP_FAILED) return nullptr;
+        auto base = reinterpret_cast<std::uint8_t *>(align_up(reinterpret_cast<std::uintptr_t>(reservation), SLAB_SIZE));
+        if(base != reservation) munmap(reservation, base - reservation);
+        munmap(base + 2 * size, reservation + 2 * size + SLAB_SIZE - (base + 2 * size));
+        auto writable = mmap(base, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0);
+        auto executable = mmap(base + size, size, PROT_READ | PROT_EXEC, MAP_SHARED | MAP_FIXED, fd, 0);
+        if(writable == MAP_FAILED || executable == MAP_FAILED){
+            munmap(base, 2 * size);
+            return nullptr;
+        }
+        return base;
+    }
+
+    /**
+     * @brief `size` バイト以上のスラブを確保する．
+     *
+     * `option::HugePages::Explicit` で大きなページを確保できなければ（予約が無い等），通常のページで確保する．
+     */
+    Slab *SlabAllocator::map(std::size_t size){
+        size = align_up(size, SLAB_SIZE);
+        int fd = -1;
+        std::uint8_t *base = nullptr;
+        if(huge_pages == option::HugePages::Explicit){
+            fd = memfd_create("jit", MFD_CLOEXEC | MFD_HUGETLB);
+            if(fd >= 0 && ftruncate(fd, size) == 0) base = map_views(fd, size);
+            if(!base && fd >= 0) close(fd);
+        }
+        if(!base){
+            fd = memfd_create("jit", MFD_CLOEXEC);
+            if(fd < 0 || ftruncate(fd, size) != 0) llvm::report_fatal_error("cannot allocate JIT memory");
+            base = map_views(fd, size);
+            if(!base) llvm::report_fatal_error("cannot map JIT memory");
+        }
+        if(huge_pages == option::HugePages::Transparent) madvise(base, 2 * size, MADV_HUGEPAGE);
+        statistics.slabs_mapped++;
+        memstats::count_mapping(size);
+        auto &slab = slabs.emplace_back(std::make_unique<Slab>(Slab{fd, base, base + size, size, 0, 0}));
+        return slab.get();
+    }
+
+    //! スラブの割り当てを解除する．
+    void SlabAllocator::unmap(Slab *slab){
+        munmap(slab->writable, 2 * slab->size);
+        close(slab->fd);
+        statistics.slabs_unmapped++;
+        memstats::count_mapping(-static_cast<std::ptrdiff_t>(slab->size));
+    }
+
+    /**
+     * @brief `size` バイトを切り出せるスラブを選び，使う側を 1 つ増やす．
+     *
+     * 今のスラブに収まらなければ新しいスラブを確保する．古いスラブは使う側がいなくなった時点で解放される．
+     */
+    Slab *SlabAllocator::reserve(std::size_t size){
+        if(!current || current->size - current->used < size){
+            if(current && current->users == 0){
+                auto old = current;
+                slabs.erase(std::find_if(slabs.begin(), slabs.end(), [old](auto &slab){ return slab.get() == old; }));
+                unmap(old);
+            }
+            current = map(std::max(size, SLAB_SIZE));
+        }
+        current->users++;
+        return current;
+    }
+
+    /**
+     * @brief スラブから `size` バイトを `alignment` に揃えて切り出す．
+     * @return 書き込み用の側のアドレス
+     * @retval nullptr 収まらない
+     */
+    std::uint8_t *SlabAllocator::allocate(Slab *slab, std::size_t size, std::size_t alignment){
+        auto offset = align_up(slab->used, std::max<std::size_t>(alignment, 1));
+        if(offset > slab->size || slab->size - offset < size) return nullptr;
+        slab->used = offset + size;
+        statistics.sections++;
+        return slab->writable + offset;
+    }
+
+    /**
+     * @brief スラブを使う側を 1 つ減らす．
+     *
+     * 誰も使わなくなったら，今のスラブなら先頭から使い直し，そうでなければ解放する．
+     */
+    void SlabAllocator::release(Slab *slab){
+        if(--slab->users) return;
+        if(slab == current){
+            slab->used = 0;
+            statistics.slabs_reused++;
+            return;
+        }
+        slabs.erase(std::find_if(slabs.begin(), slabs.end(), [slab](auto &owned){ return owned.get() == slab; }));
+        unmap(slab);
+    }
+
+    const Statistics &SlabAllocator::get_statistics() const {
+        return statistics;
+    }
+
+    //! コンストラクタ
+    MemoryManager::MemoryManager(SlabAllocator &allocator): allocator(allocator), slab(nullptr) {}
+
+    //! EH フレームの登録を解除してから，使ったスラブを返す．
+    MemoryManager::~MemoryManager(){
+        deregisterEHFrames();
+        for(auto used : used_slabs) allocator.release(used);
+    }
+
+    //! オブジェクトファイル全体の大きさを先に知り，1 つのスラブに収める．
+    bool MemoryManager::needsToReserveAllocationSpace(){ return true; }
+
+    void MemoryManager::reserveAllocationSpace(
+        std::uintptr_t code_size, std::uint32_t code_alignment,
+        std::uintptr_t read_only_size, std::uint32_t read_only_alignment,
+        std::uintptr_t read_write_size, std::uint32_t read_write_alignment
+    ){
+        auto size = code_size + code_alignment + read_only_size + read_only_alignment + read_write_size + read_write_alignment + RESERVE_SLACK;
+        slab = allocator.reserve(size);
+        used_slabs.push_back(slab);
+    }
+
+    /**
+     * @brief セクションを切り出す．
+     *
+     * 見積もりを超えたら（GOT 等），新しいスラブを使う．
+     */
+    std::uint8_t *MemoryManager::allocate(std::size_t size, unsigned alignment){
+        std::uint8_t *ret = slab ? allocator.allocate(slab, size, alignment) : nullptr;
+        if(ret) return ret;
+        slab = allocator.reserve(size + alignment);
+        used_slabs.push_back(slab);
+        return allocator.allocate(slab, size, alignment);
+    }
+
+    std::uint8_t *MemoryManager::allocateCodeSection(std::uintptr_t size, unsigned alignment, unsigned, llvm::StringRef){
+        auto ret = allocate(size, alignment);
+        code_sections.emplace_back(ret, slab->executable + (ret - slab->writable), size);
+        return ret;
+    }
+
+    //! データのセクションは書き込み用の側にそのまま置く（読み込み専用のものも権限は変えない）．
+    std::uint8_t *MemoryManager::allocateDataSection(std::uintptr_t size, unsigned alignment, unsigned, llvm::StringRef, bool){
+        return allocate(size, alignment);
+    }
+
+    //! 再配置の前に，機械語のセクションを実行用の側のアドレスにあるものとして扱わせる．
+    void MemoryManager::notifyObjectLoaded(llvm::RuntimeDyld &dyld, const llvm::object::ObjectFile &){
+        for(auto &[writable, executable, size] : code_sections){
+            dyld.mapSectionAddress(writable, reinterpret_cast<std::uintptr_t>(executable));
+        }
+    }
+
+    /**
+     * @brief 機械語を実行できるようにする．
+     *
+     * 実行用の側は初めから実行できるので，権限は変えずに命令キャッシュを無効化するだけでよい．
+     */
+    bool MemoryManager::finalizeMemory(std::string *){
+        for(auto &[writable, executable, size] : code_sections){
+            llvm::sys::Memory::InvalidateInstructionCache(executable, size);
+        }
+        return false;
+    }
+}
@@ -0,0 +1,112 @@
+/**
+ * @file memory.hpp
+ * @brief JIT でコンパイルした機械語とデータを置くメモリを管理する
+ */
+#ifndef MEMORY_HPP
+#define MEMORY_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <tuple>
+#include <vector>
+
+#include "option.hpp"
+
+#include "llvm/ExecutionEngine/RTDyldMemoryManager.h"
+
+/**
+ * @brief JIT のメモリ管理．
+ *
+ * 文ごとのモジュールは小さいので，モジュールごとにページを確保して権限を変えるのでは
+ * ページの断片化と `mmap` `mprotect` の呼び出しが文の数だけ増える．
+ * そこで大きなスラブを一度だけ確保し，多数のモジュールのセクションをそこから切り出す．
+ */
+namespace memory {
+    /**
+     * @brief 機械語とデータを切り出す大きなメモリ領域．
+     *
+     * 同じ物理ページ（`memfd`）を書き込み用（読み書き）と実行用（読み込み・実行）の 2 か所に割り当てる．
+     * 機械語は書き込み用の側に書いて実行用の側のアドレスで実行するので，権限を変える `mprotect` は要らない．
+     * 2 つの割り当ては隣り合わせなので，同じスラブの中のセクションどうしは 32 ビットの相対アドレスで届く．
+     */
+    struct Slab {
+        int fd;
+        std::uint8_t *writable;
+        std::uint8_t *executable;
+        std::size_t size;
+        //! 先頭から切り出し済みのバイト数
+        std::size_t used;
+        //! このスラブからセクションを切り出した，まだ解放されていない `MemoryManager` の数
+        std::size_t users;
+    };
+
+    /**
+     * @brief 割り当ての回数などの統計
+     */
+    struct Statistics {
+        //! 確保したスラブの数（`mmap` はスラブごとに 3 回）
+        std::size_t slabs_mapped = 0;
+        //! 解放したスラブの数
+        std::size_t slabs_unmapped = 0;
+        //! 切り出したセクションの数
+        std::size_t sections = 0;
+        //! 使い終わって先頭から使い直したスラブの数
+        std::size_t slabs_reused = 0;
+    };
+
+    /**
+     * @brief スラブを確保し，セクションを切り出すクラス．
+     *
+     * スラブは先頭から順に切り出すだけで，個々のセクションは解放しない．
+     * スラブを使うモジュールがすべて解放されたら，スラブごと解放する（使用中のスラブなら先頭から使い直す）．
+     */
+    class SlabAllocator {
+        std::vector<std::unique_ptr<Slab>> slabs;
+        //! 新しいモジュールのセクションを切り出すスラブ
+        Slab *current;
+        option::HugePages huge_pages;
+        Statistics statistics;
+        Slab *map(std::size_t);
+        void unmap(Slab *);
+    public:
+        SlabAllocator(option::HugePages);
+        ~SlabAllocator();
+        SlabAllocator(const SlabAllocator &) = delete;
+        SlabAllocator &operator=(const SlabAllocator &) = delete;
+        Slab *reserve(std::size_t);
+        std::uint8_t *allocate(Slab *, std::size_t, std::size_t);
+        void release(Slab *);
+        const Statistics &get_statistics() const;
+    };
+
+    /**
+     * @brief `llvm::orc::RTDyldObjectLinkingLayer` がオブジェクトファイルごとに作るメモリマネージャ．
+     *
+     * セクションは `SlabAllocator` のスラブから切り出す．機械語のセクションは，読み込み後に
+     * 実行用の側のアドレスへ移したことにする（`llvm::RuntimeDyld::mapSectionAddress()`）．
+     * モジュールが解放されてこのオブジェクトが破棄されたら，使ったスラブを `SlabAllocator::release()` する．
+     */
+    class MemoryManager : public llvm::RTDyldMemoryManager {
+        SlabAllocator &allocator;
+        //! `reserveAllocationSpace()` で選んだスラブ
+        Slab *slab;
+        //! `SlabAllocator::reserve()` したスラブ
+        std::vector<Slab *> used_slabs;
+        //! 機械語のセクションの書き込み用と実行用のアドレスと大きさ
+        std::vector<std::tuple<std::uint8_t *, std::uint8_t *, std::size_t>> code_sections;
+        std::uint8_t *allocate(std::size_t, unsigned);
+    public:
+        using llvm::RTDyldMemoryManager::notifyObjectLoaded;
+        MemoryManager(SlabAllocator &);
+        ~MemoryManager() override;
+        bool needsToReserveAllocationSpace() override;
+        void reserveAllocationSpace(std::uintptr_t, std::uint32_t, std::uintptr_t, std::uint32_t, std::uintptr_t, std::uint32_t) override;
+        std::uint8_t *allocateCodeSection(std::uintptr_t, unsigned, unsigned, llvm::StringRef) override;
+        std::uint8_t *allocateDataSection(std::uintptr_t, unsigned, unsigned, llvm::StringRef, bool) override;
+        void notifyObjectLoaded(llvm::RuntimeDyld &, const llvm::object::ObjectFile &) override;
+        bool finalizeMemory(std::string * = nullptr) override;
+    };
+}
+
+#endif
@@ -0,0 +1,170 @@
+/**
+ * @file memstats.cpp
+ */
+#include "memstats.hpp"
+
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <new>
+
+#include <malloc.h>
+#include <sys/resource.h>
+
+#include "llvm/Support/Process.h"
+#include "llvm/Support/TimeProfiler.h"
+
+namespace memstats {
+    static constexpr std::size_t PHASES = static_cast<std::size_t>(Phase::Execute) + 1;
+    static const char *const PHASE_NAMES[PHASES] = {"other", "lex", "parse", "resolve", "compile", "optimize", "codegen", "jit", "execute"};
+
+    //! 1 つの段階で確保・解放した回数とバイト数
+    struct Counts {
+        std::atomic<std::uint64_t> allocations;
+        std::atomic<std::uint64_t> allocated;
+        std::atomic<std::uint64_t> frees;
+        std::atomic<std::uint64_t> freed;
+        //! この段階にいる間の `live` の最大値
+        std::atomic<std::int64_t> peak;
+    };
+
+    //! `start()` したか（`operator new` より先に初期化されるよう，すべて定数で初期化する）
+    static std::atomic<bool> enabled(false);
+    static Counts counts[PHASES];
+    //! `start()` してから確保して解放していないバイト数（前に確保したものを解放すると減るので，負になりうる）
+    static std::atomic<std::int64_t> live(0);
+    static std::atomic<std::int64_t> peak(0);
+    //! JIT のスラブのバイト数
+    static std::atomic<std::int64_t> mapped(0);
+    static std::atomic<std::int64_t> peak_mapped(0);
+    static thread_local Phase current = Phase::Other;
+
+    static void raise(std::atomic<std::int64_t> &maximum, std::int64_t value){
+        auto old = maximum.load(std::memory_order_relaxed);
+        while(old < value && !maximum.compare_exchange_weak(old, value, std::memory_order_relaxed));
+    }
+
+    //! `operator new` が確保した `pointer` を今の段階に数える．
+    static void count_allocation(void *pointer){
+        std::int64_t size = malloc_usable_size(pointer);
+        auto &phase = counts[static_cast<std::size_t>(current)];
+        phase.allocations.fetch_add(1, std::memory_order_relaxed);
+        phase.allocated.fetch_add(size, std::memory_order_relaxed);
+        auto now = live.fetch_add(size, std::memory_order_relaxed) + size;
+        raise(peak, now);
+        raise(phase.peak, now);
+    }
+
+    //! `operator delete` が解放する `pointer` を今の段階に数える．
+    static void count_free(void *pointer){
+        std::int64_t size = malloc_usable_size(pointer);
+        auto &phase = counts[static_cast<std::size_t>(current)];
+        phase.frees.fetch_add(1, std::memory_order_relaxed);
+        phase.freed.fetch_add(size, std::memory_order_relaxed);
+        live.fetch_sub(size, std::memory_order_relaxed);
+    }
+
+    Scope::Scope(Phase phase): previous(current) {
+        current = phase;
+    }
+
+    /**
+     * @brief 元の段階に戻す．
+     *
+     * `--time-trace` なら，抜けた段階とその時点の統計を `Memory` の区間として記録する．
+     */
+    Scope::~Scope(){
+        auto phase = current;
+        current = previous;
+        if(!enabled.load(std::memory_order_relaxed)) return;
+        llvm::TimeTraceScope scope("Memory", [&](){ return std::string(PHASE_NAMES[static_cast<std::size_t>(phase)]) + ": " + describe(); });
+    }
+
+    //! 数え始める．
+    void start(){
+        enabled = true;
+    }
+
+    /**
+     * @brief JIT のスラブを `bytes` バイト確保した（負なら解放した）ことを数える．
+     *
+     * `start()` していなくても数える（スラブの確保は少ない）．
+     */
+    void count_mapping(std::ptrdiff_t bytes){
+        raise(peak_mapped, mapped.fetch_add(bytes, std::memory_order_relaxed) + bytes);
+    }
+
+    //! 今の生きているバイト数とその最大値，JIT のスラブのバイト数
+    std::string describe(){
+        return
+            "live " + std::to_string(live.load(std::memory_order_relaxed)) +
+            " bytes (peak " + std::to_string(peak.load(std::memory_order_relaxed)) +
+            "), JIT slabs " + std::to_string(mapped.load(std::memory_order_relaxed)) + " bytes";
+    }
+
+    /**
+     * @brief 段階ごとの統計と，プロセス全体のメモリの使用量を標準エラー出力に出力する．
+     *
+     * 段階ごとに確保・解放の回数とバイト数，その差，その段階にいる間の生きているバイト数の最大値を出す．
+     * 続けて `operator new` 全体の生きているバイト数と最大値，malloc 全体の使用量（`llvm::sys::Process::GetMallocUsage()`），
+     * JIT のスラブ，最大の常駐セットサイズを出す．
+     */
+    void report(){
+        enabled = false;
+        std::cerr << "memory by phase:" << std::endl;
+        std::cerr
+            << std::left << std::setw(10) << "phase" << std::right
+            << std::setw(14) << "allocations" << std::setw(16) << "bytes"
+            << std::setw(14) << "frees" << std::setw(16) << "bytes freed"
+            << std::setw(16) << "net bytes" << std::setw(16) << "peak live" << std::endl;
+        for(std::size_t i = 0; i < PHASES; ++i){
+            auto &phase = counts[i];
+            auto allocations = phase.allocations.load(), frees = phase.frees.load();
+            if(!allocations && !frees) continue;
+            auto allocated = phase.allocated.load(), freed = phase.freed.load();
+            std::cerr
+                << std::left << std::setw(10) << PHASE_NAMES[i] << std::right
+                << std::setw(14) << allocations << std::setw(16) << allocated
+                << std::setw(14) << frees << std::setw(16) << freed
+                << std::setw(16) << static_cast<std::int64_t>(allocated - freed)
+                << std::setw(16) << phase.peak.load() << std::endl;
+        }
+        rusage usage{};
+        getrusage(RUSAGE_SELF, &usage);
+        std::cerr
+            << "operator new: live " << live.load() << " bytes, peak " << peak.load() << " bytes" << std::endl
+            << "malloc in use (including LLVM's own allocators): " << llvm::sys::Process::GetMallocUsage() << " bytes" << std::endl
+            << "JIT slabs: live " << mapped.load() << " bytes, peak " << peak_mapped.load() << " bytes" << std::endl
+            << "max resident set: " << usage.ru_maxrss << " KiB" << std::endl;
+    }
+}
+
+/**
+ * @brief 大域の `operator new` の置き換え（`memstats` を参照）
+ *
+ * 配列版と `std::nothrow` 版は，標準ライブラリの既定の実装がこれを呼ぶ．
+ * アラインメントを指定する版は置き換えないので，数えない．
+ */
+void *operator new(std::size_t size){
+    void *ret;
+    while(!(ret = std::malloc(size ? size : 1))){
+        auto handler = std::get_new_handler();
+        if(!handler) throw std::bad_alloc();
+        handler();
+    }
+    if(memstats::enabled.load(std::memory_order_relaxed)) memstats::count_allocation(ret);
+    return ret;
+}
+
+//! 大域の `operator delete` の置き換え（配列版は，既定の実装がこれを呼ぶ）
+void operator delete(void *pointer) noexcept {
+    if(pointer && memstats::enabled.load(std::memory_order_relaxed)) memstats::count_free(pointer);
+    std::free(pointer);
+}
+
+//! サイズ付きの `operator delete` の置き換え（大きさは `malloc_usable_size()` で求めるので使わない）
+void operator delete(void *pointer, std::size_t) noexcept {
+    operator delete(pointer);
+}
@@ -0,0 +1,60 @@
+/**
+ * @file memstats.hpp
+ * @brief 各段階で確保・解放したメモリを数える
+ */
+#ifndef MEMSTATS_HPP
+#define MEMSTATS_HPP
+
+#include <cstddef>
+#include <string>
+
+/**
+ * @brief `--mem-stats` で，ヒープの確保と解放を処理の段階ごとに数える．
+ *
+ * 大域の `operator new` `operator delete` を置き換え，`start()` した後はその時点の段階（`Phase`）に回数とバイト数を足す．
+ * 段階はスレッドごとに持ち，`Scope` で入れ子に切り替える．バイト数は `malloc_usable_size()`（実際に確保された大きさ）．
+ * 解放は，確保した段階ではなく解放した段階に数える（確保したブロックに段階を書き込まないため）．
+ * `start()` していなければ，確保と解放に分岐が 1 つ増えるだけで何も数えない．
+ *
+ * 段階はおおよそ部品に対応する．`Lexer::log` とトークンは `Lex`，AST のノードと `value::Type` は `Parse` と `Resolve`，
+ * LLVM のモジュールは `Compile`，最適化と機械語の生成は `Optimize` `Codegen`，`llvm::orc` の管理は `JIT` に数えられる．
+ *
+ * `operator new` を通らない確保（LLVM の `BumpPtrAllocator` の `malloc` など）は，`report()` で malloc 全体の使用量として出す．
+ * JIT の機械語とデータのスラブ（`memory::SlabAllocator`）は `mmap` なので，`count_mapping()` で別に数える．
+ * `--time-trace` にも，段階を抜けるたびにその時点の生きているバイト数を `Memory` の区間として記録する．
+ */
+namespace memstats {
+    //! 処理の段階（`--time-trace` の区間とおおよそ同じ）
+    enum class Phase : unsigned char {
+        Other,
+        Lex,
+        Parse,
+        Resolve,
+        Compile,
+        Optimize,
+        Codegen,
+        JIT,
+        Execute,
+    };
+
+    /**
+     * @brief 生きている間，このスレッドの確保と解放を `phase` に数えるクラス．
+     *
+     * 破棄されると元の段階に戻す．
+     */
+    class Scope {
+        Phase previous;
+    public:
+        explicit Scope(Phase);
+        ~Scope();
+        Scope(const Scope &) = delete;
+        Scope &operator=(const Scope &) = delete;
+    };
+
+    void start();
+    void count_mapping(std::ptrdiff_t);
+    std::string describe();
+    void report();
+}
+
+#endif
@@ -0,0 +1,43 @@
+/**
+ * @file optimizer.cpp
+ */
+#include "optimizer.hpp"
+#include "memstats.hpp"
+#include "trace.hpp"
+
+#include "llvm/Config/llvm-config.h"
+#include "llvm/Passes/PassBuilder.h"
+
+#if LLVM_VERSION_MAJOR >= 14
+using OptimizationLevel = llvm::OptimizationLevel;
+#else
+using OptimizationLevel = llvm::PassBuilder::OptimizationLevel;
+#endif
+
+/**
+ * @brief モジュールに `-O2` 相当の最適化をかける．
+ *
+ * `InternalLinkage` の大域変数（`Context::program_module()`）は GlobalOpt によってレジスタに昇格されたり定数伝播されたりする．
+ * `--time-trace` には最適化する前のモジュールの統計を詳細として `Optimize` の区間を記録する（中に各パスの区間が入る）．
+ */
+void optimize(llvm::Module &module){
+    llvm::TimeTraceScope scope("Optimize", [&](){ return trace::describe(module); });
+    memstats::Scope phase(memstats::Phase::Optimize);
+    llvm::LoopAnalysisManager loop_analysis_manager;
+    llvm::FunctionAnalysisManager function_analysis_manager;
+    llvm::CGSCCAnalysisManager cgscc_analysis_manager;
+    llvm::ModuleAnalysisManager module_analysis_manager;
+    llvm::PassBuilder pass_builder;
+    pass_builder.registerModuleAnalyses(module_analysis_manager);
+    pass_builder.registerCGSCCAnalyses(cgscc_analysis_manager);
+    pass_builder.registerFunctionAnalyses(function_analysis_manager);
+    pass_builder.registerLoopAnalyses(loop_analysis_manager);
+    pass_builder.crossRegisterProxies(
+        loop_analysis_manager,
+        function_analysis_manager,
+        cgscc_analysis_manager,
+        module_analysis_manager
+    );
+    auto module_pass_manager = pass_builder.buildPerModuleDefaultPipeline(OptimizationLevel::O2);
+    module_pass_manager.run(module, module_analysis_manager);
+}
@@ -0,0 +1,12 @@
+/**
+ * @file optimizer.hpp
+ * @brief 生成したモジュールを最適化する
+ */
+#ifndef OPTIMIZER_HPP
+#define OPTIMIZER_HPP
+
+#include "llvm/IR/Module.h"
+
+void optimize(llvm::Module &);
+
+#endif
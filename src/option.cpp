@@ -0,0 +1,244 @@
+/**
+ * @file option.cpp
+ */
+#include "option.hpp"
+
+#include <iostream>
+#include <string_view>
+
+#include "llvm/ADT/SmallString.h"
+#include "llvm/Support/Path.h"
+
+namespace option {
+    //! コンストラクタ
+    Option::Option(): cpu("generic"), lazy(false), adaptive(false), backend(Backend::LLVM), branchless(true), huge_pages(HugePages::Off), counters(false), debug_info(false), mem_stats(false) {}
+
+    //! 登録先が 1 つでもあるか
+    bool JITEvents::any() const {
+        return perf_map || jitdump || gdb;
+    }
+
+    //! 報告する種類が 1 つでもあるか
+    bool RemarkKinds::any() const {
+        return passed || missed || analysis;
+    }
+
+    /**
+     * @brief 出力先のパスを返す．
+     *
+     * `-o` が指定されていなければ，実行ファイルは `a.out`，
+     * それ以外は入力ファイルの拡張子を `.ll` `.bc` `.s` `.o` に置き換えたもの（入力が標準入力なら `-` つまり標準出力）．
+     */
+    std::string Option::output_path() const {
+        if(output) return output.value();
+        if(emit == Emit::Executable) return "a.out";
+        if(!input) return "-";
+        llvm::SmallString<128> path(input.value());
+        switch(emit.value()){
+            case Emit::IR: llvm::sys::path::replace_extension(path, "ll"); break;
+            case Emit::Bitcode: llvm::sys::path::replace_extension(path, "bc"); break;
+            case Emit::Assembly: llvm::sys::path::replace_extension(path, "s"); break;
+            case Emit::Object: llvm::sys::path::replace_extension(path, "o"); break;
+            case Emit::Executable: break;
+        }
+        return std::string(path);
+    }
+
+    static void print_usage(std::string_view program){
+        std::cerr
+            << "usage: " << program << " [options] [file]" << std::endl
+            << "  --emit=ir|bc|asm|obj|exe  compile ahead of time instead of running" << std::endl
+            << "  -o <file>                 output path" << std::endl
+            << "  --cpu=<name>              target CPU (`native` for the host CPU)" << std::endl
+            << "  --lazy                    compile each sentence of the file when it is first run" << std::endl
+            << "  --backend=llvm|vm         run with the LLVM JIT (default) or the bytecode VM" << std::endl
+            << "  --adaptive                evaluate small loop-free sentences without compiling (interactive only)" << std::endl
+            << "  --branchless=on|off       lower side-effect-free && || and simple if-assignments to select (default on)" << std::endl
+            << "  --huge-pages=off|transparent|explicit" << std::endl
+            << "                            back JIT code and data with huge pages (default off)" << std::endl
+            << "  --time-trace=<file>       write the time spent in each phase as Chrome trace event JSON" << std::endl
+            << "  --counters                count executions of sentences, loop iterations and branches, and report the hottest lines" << std::endl
+            << "  --jit-events=perf-map,jitdump,gdb" << std::endl
+            << "                            register JIT-compiled sentences with perf and GDB" << std::endl
+            << "  -g                        generate DWARF debug info mapping machine code to source lines" << std::endl
+            << "  --profile=<file>          sample the running code and write folded stacks per sentence and line" << std::endl
+            << "  --pgo-gen=<file>          count branches while running and write them as a profile" << std::endl
+            << "  --pgo-use=<file>          optimize with branch weights and entry counts from a --pgo-gen profile" << std::endl
+            << "  --remarks=passed,missed,analysis" << std::endl
+            << "                            report optimization remarks with the source they refer to" << std::endl
+            << "  --remarks-yaml=<file>     also write the remarks as YAML" << std::endl
+            << "  --mem-stats               count heap allocations per phase and report peak and live bytes" << std::endl;
+    }
+
+    /**
+     * @brief コマンドライン引数を読む．
+     * @retval std::nullopt 不正な引数があった（使い方を標準エラー出力に出力済み）
+     */
+    std::optional<Option> parse(int argc, char *argv[]){
+        Option ret;
+        for(int i = 1; i < argc; ++i){
+            std::string_view arg = argv[i];
+            if(arg.starts_with("--emit=")){
+                auto kind = arg.substr(7);
+                if(kind == "ir") ret.emit = Emit::IR;
+                else if(kind == "bc") ret.emit = Emit::Bitcode;
+                else if(kind == "asm") ret.emit = Emit::Assembly;
+                else if(kind == "obj") ret.emit = Emit::Object;
+                else if(kind == "exe") ret.emit = Emit::Executable;
+                else{
+                    std::cerr << "unknown emit kind: " << kind << std::endl;
+                    print_usage(argv[0]);
+                    return std::nullopt;
+                }
+            }else if(arg == "-o"){
+                if(++i == argc){
+                    std::cerr << "missing argument to -o" << std::endl;
+                    print_usage(argv[0]);
+                    return std::nullopt;
+                }
+                ret.output = argv[i];
+            }else if(arg.starts_with("--cpu=")){
+                ret.cpu = arg.substr(6);
+            }else if(arg.starts_with("--backend=")){
+                auto backend = arg.substr(10);
+                if(backend == "llvm") ret.backend = Backend::LLVM;
+                else if(backend == "vm") ret.backend = Backend::VM;
+                else{
+                    std::cerr << "unknown backend: " << backend << std::endl;
+                    print_usage(argv[0]);
+                    return std::nullopt;
+                }
+            }else if(arg.starts_with("--branchless=")){
+                auto value = arg.substr(13);
+                if(value == "on") ret.branchless = true;
+                else if(value == "off") ret.branchless = false;
+                else{
+                    std::cerr << "unknown value for --branchless: " << value << std::endl;
+                    print_usage(argv[0]);
+                    return std::nullopt;
+                }
+            }else if(arg.starts_with("--huge-pages=")){
+                auto value = arg.substr(13);
+                if(value == "off") ret.huge_pages = HugePages::Off;
+                else if(value == "transparent") ret.huge_pages = HugePages::Transparent;
+                else if(value == "explicit") ret.huge_pages = HugePages::Explicit;
+                else{
+                    std::cerr << "unknown value for --huge-pages: " << value << std::endl;
+                    print_usage(argv[0]);
+                    return std::nullopt;
+                }
+            }else if(arg.starts_with("--time-trace=")){
+                ret.time_trace = arg.substr(13);
+            }else if(arg.starts_with("--jit-events=")){
+                auto events = arg.substr(13);
+                while(!events.empty()){
+                    auto comma = events.find(',');
+                    auto event = events.substr(0, comma);
+                    events = comma == std::string_view::npos ? std::string_view() : events.substr(comma + 1);
+                    if(event == "perf-map") ret.jit_events.perf_map = true;
+                    else if(event == "jitdump") ret.jit_events.jitdump = true;
+                    else if(event == "gdb") ret.jit_events.gdb = true;
+                    else{
+                        std::cerr << "unknown JIT event listener: " << event << std::endl;
+                        print_usage(argv[0]);
+                        return std::nullopt;
+                    }
+                }
+            }else if(arg.starts_with("--remarks=")){
+                auto kinds = arg.substr(10);
+                while(!kinds.empty()){
+                    auto comma = kinds.find(',');
+                    auto kind = kinds.substr(0, comma);
+                    kinds = comma == std::string_view::npos ? std::string_view() : kinds.substr(comma + 1);
+                    if(kind == "passed") ret.remarks.passed = true;
+                    else if(kind == "missed") ret.remarks.missed = true;
+                    else if(kind == "analysis") ret.remarks.analysis = true;
+                    else{
+                        std::cerr << "unknown kind of remarks: " << kind << std::endl;
+                        print_usage(argv[0]);
+                        return std::nullopt;
+                    }
+                }
+            }else if(arg.starts_with("--remarks-yaml=")){
+                ret.remarks_yaml = arg.substr(15);
+            }else if(arg.starts_with("--pgo-gen=")){
+                ret.pgo_gen = arg.substr(10);
+            }else if(arg.starts_with("--pgo-use=")){
+                ret.pgo_use = arg.substr(10);
+            }else if(arg.starts_with("--profile=")){
+                ret.profile = arg.substr(10);
+            }else if(arg == "-g"){
+                ret.debug_info = true;
+            }else if(arg == "--mem-stats"){
+                ret.mem_stats = true;
+            }else if(arg == "--counters"){
+                ret.counters = true;
+            }else if(arg == "--lazy"){
+                ret.lazy = true;
+            }else if(arg == "--adaptive"){
+                ret.adaptive = true;
+            }else if(arg.starts_with("-") && arg != "-"){
+                std::cerr << "unknown option: " << arg << std::endl;
+                print_usage(argv[0]);
+                return std::nullopt;
+            }else if(ret.input){
+                std::cerr << "more than one input file" << std::endl;
+                print_usage(argv[0]);
+                return std::nullopt;
+            }else if(arg != "-"){
+                ret.input = arg;
+            }
+        }
+        if(ret.backend == Backend::VM && (ret.emit || ret.lazy)){
+            std::cerr << "--emit and --lazy are not available with --backend=vm" << std::endl;
+            print_usage(argv[0]);
+            return std::nullopt;
+        }
+        if(ret.adaptive && (ret.input || ret.backend == Backend::VM)){
+            std::cerr << "--adaptive is only available in interactive mode with --backend=llvm" << std::endl;
+            print_usage(argv[0]);
+            return std::nullopt;
+        }
+        if(ret.jit_events.any() && (ret.emit || ret.backend == Backend::VM)){
+            std::cerr << "--jit-events is only available when running with the LLVM JIT" << std::endl;
+            print_usage(argv[0]);
+            return std::nullopt;
+        }
+        if(ret.debug_info && ret.backend == Backend::VM){
+            std::cerr << "-g is not available with --backend=vm" << std::endl;
+            print_usage(argv[0]);
+            return std::nullopt;
+        }
+        if(ret.profile && (ret.emit || ret.backend == Backend::VM)){
+            std::cerr << "--profile is only available when running with the LLVM JIT" << std::endl;
+            print_usage(argv[0]);
+            return std::nullopt;
+        }
+        if(ret.pgo_gen && (ret.emit || ret.backend == Backend::VM)){
+            std::cerr << "--pgo-gen is only available when running with the LLVM JIT" << std::endl;
+            print_usage(argv[0]);
+            return std::nullopt;
+        }
+        if(ret.pgo_use && ret.backend == Backend::VM){
+            std::cerr << "--pgo-use is not available with --backend=vm" << std::endl;
+            print_usage(argv[0]);
+            return std::nullopt;
+        }
+        if(ret.remarks.any() && ret.backend == Backend::VM){
+            std::cerr << "--remarks is not available with --backend=vm" << std::endl;
+            print_usage(argv[0]);
+            return std::nullopt;
+        }
+        if(ret.remarks_yaml && !ret.remarks.any()){
+            std::cerr << "--remarks-yaml requires --remarks" << std::endl;
+            print_usage(argv[0]);
+            return std::nullopt;
+        }
+        if(ret.counters && (ret.emit || ret.adaptive || ret.backend == Backend::VM)){
+            std::cerr << "--counters is only available when running with the LLVM JIT without --adaptive" << std::endl;
+            print_usage(argv[0]);
+            return std::nullopt;
+        }
+        return ret;
+    }
+}
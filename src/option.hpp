@@ -0,0 +1,126 @@
+/**
+ * @file option.hpp
+ * @brief コマンドライン引数を読む
+ */
+#ifndef OPTION_HPP
+#define OPTION_HPP
+
+#include <optional>
+#include <string>
+
+//! コマンドライン引数を読む．
+namespace option {
+    /**
+     * @brief `--emit=` で指定する出力の種類
+     */
+    enum class Emit {
+        //! LLVM IR（テキスト）
+        IR,
+        //! LLVM ビットコード
+        Bitcode,
+        //! アセンブリ
+        Assembly,
+        //! オブジェクトファイル
+        Object,
+        //! 実行ファイル
+        Executable
+    };
+
+    /**
+     * @brief `--backend=` で指定する実行方法
+     */
+    enum class Backend {
+        //! LLVM でコンパイルし，JIT で実行する
+        LLVM,
+        //! バイトコードにコンパイルし，`VM` で実行する
+        VM
+    };
+
+    /**
+     * @brief `--huge-pages=` で指定する，JIT のメモリを大きなページで確保するか
+     */
+    enum class HugePages {
+        //! 通常のページ
+        Off,
+        //! Transparent Huge Pages を使うよう `madvise` する
+        Transparent,
+        //! 予約された大きなページ（`MFD_HUGETLB`）．確保できなければ通常のページ
+        Explicit
+    };
+
+    /**
+     * @brief `--jit-events=` で指定する，JIT でコンパイルした機械語の登録先
+     */
+    struct JITEvents {
+        //! perf のシンボルの対応表 `/tmp/perf-<pid>.map`
+        bool perf_map = false;
+        //! `perf inject --jit` で読む jitdump
+        bool jitdump = false;
+        //! GDB の JIT インターフェース
+        bool gdb = false;
+        bool any() const;
+    };
+
+    /**
+     * @brief `--remarks=` で指定する，報告する最適化のリマークの種類
+     */
+    struct RemarkKinds {
+        //! 最適化できた（`llvm::OptimizationRemark`）
+        bool passed = false;
+        //! 最適化できなかった（`llvm::OptimizationRemarkMissed`）
+        bool missed = false;
+        //! 判断の理由となった分析（`llvm::OptimizationRemarkAnalysis`）
+        bool analysis = false;
+        bool any() const;
+    };
+
+    /**
+     * @brief コマンドライン引数の内容
+     */
+    struct Option {
+        //! 入力ファイル（`std::nullopt` なら標準入力）
+        std::optional<std::string> input;
+        //! 出力の種類（`std::nullopt` なら JIT で実行する）
+        std::optional<Emit> emit;
+        //! 出力先（`std::nullopt` なら入力ファイル名から決める）
+        std::optional<std::string> output;
+        //! ターゲット CPU（`native` ならホストの CPU）
+        std::string cpu;
+        //! ファイルを文ごとのモジュールにして，関数が呼び出されるまでコンパイルを遅延する
+        bool lazy;
+        //! 対話モードで，小さく繰り返しを含まない文をコンパイルせずに直接評価する
+        bool adaptive;
+        //! 実行方法
+        Backend backend;
+        //! 副作用の無い条件式や単純な代入を分岐せずにコンパイルする（`Context::branchless`）
+        bool branchless;
+        //! JIT のメモリを大きなページで確保するか（`memory::SlabAllocator`）
+        HugePages huge_pages;
+        //! 各段階にかかった時間の記録の出力先（`std::nullopt` なら記録しない，`trace`）
+        std::optional<std::string> time_trace;
+        //! 文・繰り返し・分岐の節の実行回数を数え，最後に最も多く実行された行を報告する（`Counters`）
+        bool counters;
+        //! JIT でコンパイルした機械語を登録する先（`JIT`）
+        JITEvents jit_events;
+        //! DWARF のデバッグ情報を生成する（`Context::debug_info`）
+        bool debug_info;
+        //! JIT の機械語の実行時間をサンプリングした結果の出力先（`std::nullopt` ならサンプリングしない，`Profiler`）
+        std::optional<std::string> profile;
+        //! 分岐の回数を記録したプロファイルの出力先（`std::nullopt` なら記録しない，`pgo::Instrumentation`）
+        std::optional<std::string> pgo_gen;
+        //! 最適化に使うプロファイル（`std::nullopt` なら使わない，`pgo::Profile`）
+        std::optional<std::string> pgo_use;
+        //! 報告する最適化のリマークの種類（`Remarks`）
+        RemarkKinds remarks;
+        //! リマークを YAML でも書き出す先（`std::nullopt` なら書き出さない）
+        std::optional<std::string> remarks_yaml;
+        //! 段階ごとのメモリの確保と解放を数えて報告する（`memstats`）
+        bool mem_stats;
+        Option();
+        std::string output_path() const;
+    };
+
+    std::optional<Option> parse(int, char *[]);
+}
+
+#endif
@@ -276,8 +276,9 @@ static std::vector<std::unique_ptr<expression::Expression>> parse_list(Lexer &le
  * <Sentence> ::= <Expression>? `;`
  *              | <Identifier> `:` <Type>? ( `=` <Expression> )? `;`
  *              | `{` <Sentence>* `}`
- *              | `if` `(` <Expression> `)` <Sentence> ( `else` <Sentence> )?
- *              | `while` `(` <Expression> `)` <Sentence>
+ *              | `if` <Likelihood>? `(` <Expression> `)` <Sentence> ( `else` <Sentence> )?
+ *              | `while` <Likelihood>? `(` <Expression> `)` <Sentence>
+ * <Likelihood> ::= `likely` | `unlikely`
  * @endcode
  * @retval nullptr EOF に達した．
  * @throw error::NoIdentifierBeforeColon 宣言において `:` の前に `<Identifier>` 以外の `<Expression>` か ε があった
@@ -353,8 +354,17 @@ std::unique_ptr<sentence::Sentence> parse_sentence(Lexer &lexer){
             }
         }
         if(auto keyword = token->keyword()){
-            if(keyword.value() == token::Keyword::If || keyword.value() == token::Keyword::Else){
+            if(keyword.value() == token::Keyword::If || keyword.value() == token::Keyword::While){
                 auto pos = std::move(token->pos);
+                auto likelihood = sentence::Likelihood::None;
+                if(auto &hint_ref = lexer.peek()){
+                    if(auto hint = hint_ref->keyword()){
+                        if(hint.value() == token::Keyword::Likely || hint.value() == token::Keyword::Unlikely){
+                            likelihood = hint.value() == token::Keyword::Likely ? sentence::Likelihood::Likely : sentence::Likelihood::Unlikely;
+                            lexer.next();
+                        }
+                    }
+                }
                 auto open = lexer.next();
                 if(!open) throw error::make<error::NoParenthesisAfterKeyword>(std::nullopt, std::move(token->pos));
                 if(!open->is_opening_parenthesis()) throw error::make<error::NoParenthesisAfterKeyword>(std::move(open->pos), std::move(token->pos));
@@ -373,7 +383,7 @@ std::unique_ptr<sentence::Sentence> parse_sentence(Lexer &lexer){
                                 auto else_clause = parse_sentence(lexer);
                                 if(!else_clause) throw error::make<error::UnexpectedEOFInControlStatement>(pos + pos_else);
                                 pos += else_clause->pos;
-                                auto ret = std::make_unique<sentence::If>(std::move(condition), std::move(sentence), std::move(else_clause));
+                                auto ret = std::make_unique<sentence::If>(std::move(condition), likelihood, std::move(sentence), std::move(else_clause));
                                 ret->pos = std::move(pos);
                                 return ret;
                             }
@@ -383,9 +393,9 @@ std::unique_ptr<sentence::Sentence> parse_sentence(Lexer &lexer){
                 pos += sentence->pos;
                 std::unique_ptr<sentence::Sentence> ret;
                 if(keyword.value() == token::Keyword::If){
-                    ret = std::make_unique<sentence::If>(std::move(condition), std::move(sentence), nullptr);
+                    ret = std::make_unique<sentence::If>(std::move(condition), likelihood, std::move(sentence), nullptr);
                 }else{
-                    ret = std::make_unique<sentence::While>(std::move(condition), std::move(sentence));
+                    ret = std::make_unique<sentence::While>(std::move(condition), likelihood, std::move(sentence));
                 }
                 ret->pos = std::move(pos);
                 return ret;
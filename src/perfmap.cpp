@@ -0,0 +1,47 @@
+/**
+ * @file perfmap.cpp
+ */
+#include "perfmap.hpp"
+
+#include <unistd.h>
+
+#include "llvm/Object/SymbolSize.h"
+#include "llvm/Support/Format.h"
+
+static std::string perf_map_path(){
+    return "/tmp/perf-" + std::to_string(getpid()) + ".map";
+}
+
+/**
+ * @brief コンストラクタ
+ * @param error_code `/tmp/perf-<pid>.map` を開けなかった理由
+ */
+PerfMapListener::PerfMapListener(std::error_code &error_code): stream(perf_map_path(), error_code) {}
+
+/**
+ * @brief オブジェクトファイルの関数のシンボルを，読み込まれたアドレスで書き出す．
+ *
+ * アドレスは再配置した後のもの（`llvm::RuntimeDyld::LoadedObjectInfo::getObjectForDebug()`）．
+ * perf がすぐに読めるように，1 つのオブジェクトファイルごとにフラッシュする．
+ */
+void PerfMapListener::notifyObjectLoaded(ObjectKey, const llvm::object::ObjectFile &object, const llvm::RuntimeDyld::LoadedObjectInfo &info){
+    auto debug_object = info.getObjectForDebug(object);
+    if(!debug_object.getBinary()) return;
+    for(auto &[symbol, size] : llvm::object::computeSymbolSizes(*debug_object.getBinary())){
+        auto type = symbol.getType();
+        if(!type){
+            llvm::consumeError(type.takeError());
+            continue;
+        }
+        if(type.get() != llvm::object::SymbolRef::ST_Function) continue;
+        auto name = symbol.getName();
+        auto address = symbol.getAddress();
+        if(!name || !address){
+            llvm::consumeError(name.takeError());
+            llvm::consumeError(address.takeError());
+            continue;
+        }
+        stream << llvm::format_hex_no_prefix(address.get(), 1) << " " << llvm::format_hex_no_prefix(size, 1) << " " << name.get() << "\n";
+    }
+    stream.flush();
+}
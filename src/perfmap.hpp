@@ -0,0 +1,25 @@
+/**
+ * @file perfmap.hpp
+ * @brief JIT でコンパイルした関数を perf のシンボルの対応表に書き出す
+ */
+#ifndef PERFMAP_HPP
+#define PERFMAP_HPP
+
+#include "llvm/ExecutionEngine/JITEventListener.h"
+#include "llvm/Support/raw_ostream.h"
+
+/**
+ * @brief 読み込まれたオブジェクトファイルの関数を `/tmp/perf-<pid>.map` に書き出すリスナー．
+ *
+ * perf は JIT の機械語のシンボルをこのファイルから引く．1 行が 1 つの関数で，
+ * 開始アドレス・大きさ（16 進数）・名前を空白で区切る．
+ * 解放された機械語の行は消せないので，同じアドレスに後から読み込まれた関数があれば後の行が優先される．
+ */
+class PerfMapListener : public llvm::JITEventListener {
+    llvm::raw_fd_ostream stream;
+public:
+    PerfMapListener(std::error_code &);
+    void notifyObjectLoaded(ObjectKey, const llvm::object::ObjectFile &, const llvm::RuntimeDyld::LoadedObjectInfo &) override;
+};
+
+#endif
@@ -0,0 +1,116 @@
+/**
+ * @file pgo.cpp
+ */
+#include "pgo.hpp"
+
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <vector>
+
+#include "llvm/ProfileData/InstrProf.h"
+#include "llvm/ProfileData/ProfileCommon.h"
+#include "llvm/Support/Format.h"
+#include "llvm/Support/raw_ostream.h"
+
+namespace pgo {
+    //! プロファイルの 1 行目（違えば `--pgo-gen` が書いたものではないとみなす）
+    static const std::string HEADER = "# interpreter branch profile v1";
+
+    //! 分岐 `site` のカウンタ（同じ `site` なら同じもの）
+    Counts *Instrumentation::add(Site site){
+        auto &counts = sites[site];
+        if(!counts) counts = &values.emplace_back();
+        return counts;
+    }
+
+    /**
+     * @brief 記録した回数を `path` に書き出す．
+     *
+     * 1 行が 1 つの分岐で，文の本文のハッシュ（16 進数）・番号・到達した回数・真だった回数を空白で区切る．
+     * @retval false 書き出せなかった（理由を標準エラー出力に出力済み）
+     */
+    bool Instrumentation::write(const std::string &path) const {
+        std::error_code error_code;
+        llvm::raw_fd_ostream stream(path, error_code);
+        if(error_code){
+            std::cerr << "cannot write the profile: " << error_code.message() << std::endl;
+            return false;
+        }
+        stream << HEADER << "\n";
+        for(auto &[site, counts] : sites){
+            stream
+                << llvm::format_hex_no_prefix(site.first, 16) << " "
+                << site.second << " "
+                << counts->reached << " "
+                << counts->taken << "\n";
+        }
+        return true;
+    }
+
+    /**
+     * @brief `--pgo-gen` が書き出したプロファイルを読み込み，要約を作る．
+     *
+     * 同じ分岐の行が複数あれば足し合わせる．
+     * @retval false 開けなかったか `--pgo-gen` の形式ではなかった（理由を標準エラー出力に出力済み）．プロファイル無しでコンパイルしてよい
+     */
+    bool Profile::read(const std::string &path){
+        std::ifstream file(path);
+        if(!file){
+            std::cerr << "cannot open the profile " << path << "; compiling without it" << std::endl;
+            return false;
+        }
+        std::string line;
+        if(!std::getline(file, line) || line != HEADER){
+            std::cerr << path << " is not a profile written by --pgo-gen; compiling without it" << std::endl;
+            return false;
+        }
+        while(std::getline(file, line)){
+            std::istringstream fields(line);
+            Site site;
+            Counts value;
+            if(!(fields >> std::hex >> site.first >> std::dec >> site.second >> value.reached >> value.taken)) continue;
+            if(value.taken > value.reached) continue;
+            auto &sum = counts[site];
+            sum.reached += value.reached;
+            sum.taken += value.taken;
+        }
+        std::map<std::uint64_t, std::vector<std::uint64_t>> records;
+        for(auto &[site, value] : counts){
+            auto &record = records[site.first];
+            if(record.empty() && site.second != 0) record.push_back(0);
+            record.push_back(value.reached);
+        }
+        llvm::InstrProfSummaryBuilder builder(llvm::ProfileSummaryBuilder::DefaultCutoffs.vec());
+        for(auto &[sentence, record] : records) builder.addRecord(llvm::InstrProfRecord(std::move(record)));
+        summary = builder.getSummary();
+        return true;
+    }
+
+    //! 分岐 `site` の回数（無ければ `std::nullopt`）
+    std::optional<Counts> Profile::find(Site site) const {
+        auto found = counts.find(site);
+        if(found == counts.end()) return std::nullopt;
+        return found->second;
+    }
+
+    /**
+     * @brief モジュールに付けるプロファイルの要約（`llvm::Module::setProfileSummary()`）
+     *
+     * 最適化はこれを見て，関数の実行回数や分岐の重みが熱いか冷たいかを判断する．
+     * @retval nullptr 読み込んでいない
+     */
+    llvm::Metadata *Profile::summary_metadata(llvm::LLVMContext &context) const {
+        return summary ? summary->getMD(context) : nullptr;
+    }
+
+    //! 文の本文のハッシュ（64 ビットの FNV-1a）
+    std::uint64_t hash(const std::string &text){
+        std::uint64_t ret = 0xcbf29ce484222325;
+        for(unsigned char c : text){
+            ret ^= c;
+            ret *= 0x100000001b3;
+        }
+        return ret;
+    }
+}
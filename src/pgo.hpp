@@ -0,0 +1,67 @@
+/**
+ * @file pgo.hpp
+ * @brief 分岐の回数を記録し，次の実行の最適化に使う（プロファイルに基づく最適化）
+ */
+#ifndef PGO_HPP
+#define PGO_HPP
+
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <memory>
+#include <optional>
+#include <string>
+#include <utility>
+
+#include "llvm/IR/ProfileSummary.h"
+
+/**
+ * @brief `--pgo-gen` で分岐の回数を記録し，`--pgo-use` でそれを分岐の重みと関数の実行回数にする．
+ *
+ * 分岐は，それを含むトップレベルの文の本文のハッシュと，文の中で何番目にコンパイルした分岐か（`Site`）で識別する．
+ * 本文が変わらなければ同じ順にコンパイルされるので，他の文を書き換えても番号はずれない．
+ * 各文の 0 番は文の入口（関数の実行回数），1 番以降は if・while の条件や `&&` `||` の左辺．
+ * 同じ本文の文は同じ回数を共有する．
+ */
+namespace pgo {
+    //! 分岐の位置（文の本文のハッシュと，文の中の番号）
+    using Site = std::pair<std::uint64_t, unsigned>;
+
+    //! 分岐に到達した回数と，そのうち条件が真だった回数
+    struct Counts {
+        std::uint64_t reached = 0;
+        std::uint64_t taken = 0;
+    };
+
+    /**
+     * @brief `--pgo-gen` で，生成したコードが回数を直接書き込むカウンタ（`Context::profile_branch()`）
+     */
+    class Instrumentation {
+        //! カウンタ（`std::deque` なので，後から増えても機械語に埋め込んだアドレスは変わらない）
+        std::deque<Counts> values;
+        std::map<Site, Counts *> sites;
+    public:
+        Counts *add(Site);
+        bool write(const std::string &) const;
+    };
+
+    /**
+     * @brief `--pgo-use` で読み込んだ回数
+     *
+     * 書式が壊れた行や，到達した回数より真の回数が多い行は無視する．
+     * 本文が変わった文の分岐は見つからないだけなので，重みを付けずにコンパイルされる．
+     */
+    class Profile {
+        std::map<Site, Counts> counts;
+        //! すべての回数から作ったプロファイルの要約（どの回数から熱いとみなすか）
+        std::unique_ptr<llvm::ProfileSummary> summary;
+    public:
+        bool read(const std::string &);
+        std::optional<Counts> find(Site) const;
+        llvm::Metadata *summary_metadata(llvm::LLVMContext &) const;
+    };
+
+    std::uint64_t hash(const std::string &);
+}
+
+#endif
@@ -58,10 +58,39 @@ namespace pos {
     /**
      * @brief クローン
      */
-    Range Range::clone(){
+    Range Range::clone() const {
         return Range(start, end);
     }
 
+    /**
+     * @brief 開始位置を返す．
+     */
+    Pos Range::get_start() const {
+        return start;
+    }
+
+    /**
+     * @brief 終了位置（自身含まない）を返す．
+     */
+    Pos Range::get_end() const {
+        return end;
+    }
+
+    /**
+     * @brief ソースコードから範囲の文字列を切り出す．
+     *
+     * 複数行にまたがる場合は，各行を改行でつなぐ．
+     * @param source ソースコード（文字列）
+     */
+    std::string Range::text(const std::vector<std::string> &source) const {
+        auto [sline, sbyte] = start.into_inner();
+        auto [eline, ebyte] = end.into_inner();
+        if(sline == eline) return source[sline].substr(sbyte, ebyte - sbyte);
+        std::string ret = source[sline].substr(sbyte);
+        for(auto line = sline + 1; line < eline; ++line) ret += "\n" + source[line];
+        return ret + "\n" + source[eline].substr(0, ebyte);
+    }
+
     /**
      * @brief Pos から `line`，`byte` の値を取り出す．
      * @return `first` が `line`，`second` が `byte`．
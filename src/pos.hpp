@@ -40,7 +40,10 @@ namespace pos {
         Range &operator=(Range &&);
         Range &operator+=(const Range &);
         friend Range operator+(const Range &, const Range &);
-        Range clone();
+        Range clone() const;
+        Pos get_start() const;
+        Pos get_end() const;
+        std::string text(const std::vector<std::string> &) const;
         friend std::ostream &operator<<(std::ostream &, const Range &);
         void eprint(const std::vector<std::string> &) const;
     };
@@ -0,0 +1,229 @@
+/**
+ * @file profiler.cpp
+ */
+#include "profiler.hpp"
+
+#include <algorithm>
+#include <iostream>
+#include <iterator>
+
+#include <sys/syscall.h>
+#include <ucontext.h>
+#include <unistd.h>
+
+#include "llvm/DebugInfo/DWARF/DWARFContext.h"
+#include "llvm/Object/SymbolSize.h"
+#include "llvm/Support/raw_ostream.h"
+
+#ifndef sigev_notify_thread_id
+#define sigev_notify_thread_id _sigev_un._tid
+#endif
+
+/**
+ * @brief サンプリングの間隔（メインスレッドの CPU 時間，ナノ秒）
+ *
+ * カーネルは CPU 時間のタイマーをティックごとに調べるので，実際の間隔はティックの長さに切り上がる．
+ */
+static constexpr long SAMPLING_INTERVAL = 1'000'000;
+/**
+ * @brief 解決を待つサンプルの最大数
+ *
+ * 文の機械語が解放されるたびに解決するので，1 つの文の実行が約 4 分を超えなければ溢れない．
+ */
+static constexpr std::size_t SAMPLE_CAPACITY = 1 << 18;
+
+//! シグナルハンドラが書き込む先（`start()` から `stop()` までの間だけ設定する）
+static std::atomic<Profiler *> active_profiler(nullptr);
+
+//! コンストラクタ
+Profiler::Profiler(): samples(SAMPLE_CAPACITY), sample_count(0), dropped(0), timer(), running(false) {}
+
+//! デストラクタ（タイマーが動いていれば止める）
+Profiler::~Profiler(){
+    stop();
+}
+
+//! シグナルで割り込まれたアドレス
+static std::uintptr_t program_counter(void *context){
+    auto ucontext = static_cast<ucontext_t *>(context);
+#if defined(__x86_64__)
+    return static_cast<std::uintptr_t>(ucontext->uc_mcontext.gregs[REG_RIP]);
+#elif defined(__aarch64__)
+    return static_cast<std::uintptr_t>(ucontext->uc_mcontext.pc);
+#else
+    static_cast<void>(ucontext);
+    return 0;
+#endif
+}
+
+/**
+ * @brief `SIGPROF` のハンドラ．割り込まれたアドレスを `samples` の末尾に書く．
+ *
+ * タイマーはメインスレッドにだけシグナルを送るので，`resolve_samples()` と同時に動くことはない．
+ */
+void Profiler::handle(int, siginfo_t *, void *context){
+    auto profiler = active_profiler.load(std::memory_order_relaxed);
+    if(!profiler) return;
+    auto count = profiler->sample_count.load(std::memory_order_relaxed);
+    if(count == profiler->samples.size()){
+        profiler->dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    profiler->samples[count] = program_counter(context);
+    profiler->sample_count.store(count + 1, std::memory_order_release);
+}
+
+/**
+ * @brief サンプリングを始める．
+ *
+ * 呼び出したスレッドの CPU 時間で `SAMPLING_INTERVAL` ごとに，そのスレッドへ `SIGPROF` を送るタイマーを作る．
+ * 入力を待っている間は CPU 時間が進まないので，対話モードでも実行やコンパイルの時間だけが記録される．
+ * @retval false タイマーを作れなかった（理由を標準エラー出力に出力済み）
+ */
+bool Profiler::start(){
+    struct sigaction action{};
+    action.sa_sigaction = handle;
+    action.sa_flags = SA_SIGINFO | SA_RESTART;
+    sigemptyset(&action.sa_mask);
+    if(sigaction(SIGPROF, &action, nullptr)){
+        std::perror("cannot install the SIGPROF handler");
+        return false;
+    }
+    struct sigevent event{};
+    event.sigev_notify = SIGEV_THREAD_ID;
+    event.sigev_signo = SIGPROF;
+    event.sigev_notify_thread_id = static_cast<pid_t>(syscall(SYS_gettid));
+    if(timer_create(CLOCK_THREAD_CPUTIME_ID, &event, &timer)){
+        std::perror("cannot create the profiling timer");
+        return false;
+    }
+    active_profiler = this;
+    running = true;
+    itimerspec interval{{0, SAMPLING_INTERVAL}, {0, SAMPLING_INTERVAL}};
+    timer_settime(timer, 0, &interval, nullptr);
+    return true;
+}
+
+/**
+ * @brief サンプリングを止める．
+ *
+ * 削除したタイマーのシグナルが後から届いても終了しないよう，ハンドラは設定したままにして何もさせない．
+ */
+void Profiler::stop(){
+    if(!running) return;
+    timer_delete(timer);
+    active_profiler = nullptr;
+    running = false;
+}
+
+/**
+ * @brief アドレス `address` のサンプルのフレームを `;` でつないだもの．
+ *
+ * JIT の関数 `f<N>` の中なら，そのモジュール `m<N>`・関数・（行番号表があれば）行の順にする．
+ */
+std::string Profiler::stack(std::uintptr_t address) const {
+    auto next = functions.upper_bound(address);
+    if(next == functions.begin() || address >= std::prev(next)->second.end) return "interpreter;[native]";
+    auto &function = std::prev(next)->second;
+    std::string ret = "interpreter;";
+    auto &name = function.name;
+    auto digits = name.find_first_not_of("0123456789", 1);
+    if(name.starts_with("f") && digits != 1) ret += "m" + name.substr(1, digits - 1) + ";";
+    ret += name;
+    auto line = std::upper_bound(
+        function.lines.begin(),
+        function.lines.end(),
+        address,
+        [](std::uintptr_t address, const std::pair<std::uint64_t, std::uint32_t> &line){ return address < line.first; }
+    );
+    if(line != function.lines.begin() && std::prev(line)->second){
+        ret += ";" + function.file + ":" + std::to_string(std::prev(line)->second);
+    }
+    return ret;
+}
+
+/**
+ * @brief たまったサンプルを今読み込まれている関数で解決し，`stacks` に数える．
+ *
+ * 解決している間に届いたサンプルも続けて解決してから，`samples` を空にする．
+ */
+void Profiler::resolve_samples(){
+    std::size_t resolved = 0;
+    while(true){
+        auto count = sample_count.load(std::memory_order_acquire);
+        for(; resolved < count; ++resolved) stacks[stack(samples[resolved])]++;
+        if(sample_count.compare_exchange_strong(count, 0)) return;
+    }
+}
+
+/**
+ * @brief 読み込まれたオブジェクトファイルの関数のアドレスの範囲と行番号表を記録する．
+ *
+ * アドレスは再配置した後のもの（`llvm::RuntimeDyld::LoadedObjectInfo::getObjectForDebug()`）．
+ * 行番号表はデバッグ情報（`Context::debug_info`）から読む．
+ */
+void Profiler::notifyObjectLoaded(ObjectKey key, const llvm::object::ObjectFile &object, const llvm::RuntimeDyld::LoadedObjectInfo &info){
+    auto debug_object = info.getObjectForDebug(object);
+    auto binary = debug_object.getBinary();
+    if(!binary) return;
+    auto dwarf = llvm::DWARFContext::create(*binary);
+    for(auto &[symbol, size] : llvm::object::computeSymbolSizes(*binary)){
+        auto type = symbol.getType();
+        if(!type){
+            llvm::consumeError(type.takeError());
+            continue;
+        }
+        if(type.get() != llvm::object::SymbolRef::ST_Function) continue;
+        auto name = symbol.getName();
+        auto address = symbol.getAddress();
+        auto section = symbol.getSection();
+        if(!name || !address || !section){
+            llvm::consumeError(name.takeError());
+            llvm::consumeError(address.takeError());
+            llvm::consumeError(section.takeError());
+            continue;
+        }
+        if(section.get() == binary->section_end()) continue;
+        Function function{address.get() + size, key, name.get().str(), "", {}};
+        auto lines = dwarf->getLineInfoForAddressRange(
+            {address.get(), section.get()->getIndex()},
+            size,
+            llvm::DILineInfoSpecifier(llvm::DILineInfoSpecifier::FileLineInfoKind::RawValue)
+        );
+        for(auto &[line_address, line] : lines){
+            if(line.Line && function.file.empty()) function.file = line.FileName;
+            function.lines.emplace_back(line_address, line.Line);
+        }
+        functions.insert_or_assign(address.get(), std::move(function));
+    }
+}
+
+/**
+ * @brief オブジェクトファイルが解放される前に，それまでのサンプルを解決してから関数の記録を消す．
+ *
+ * 解放された機械語のアドレスには後で別の文が読み込まれるので，先に解決しないと別の文のサンプルになってしまう．
+ */
+void Profiler::notifyFreeingObject(ObjectKey key){
+    resolve_samples();
+    std::erase_if(functions, [key](const auto &function){ return function.second.key == key; });
+}
+
+/**
+ * @brief サンプリングを止め，集計を folded stacks 形式で `path` に書き出す．
+ *
+ * `samples` が溢れて捨てたサンプルは `interpreter;[dropped]` に数える．
+ * @retval false 書き出せなかった（理由を標準エラー出力に出力済み）
+ */
+bool Profiler::write(const std::string &path){
+    stop();
+    resolve_samples();
+    std::error_code error_code;
+    llvm::raw_fd_ostream stream(path, error_code);
+    if(error_code){
+        std::cerr << "cannot write the profile: " << error_code.message() << std::endl;
+        return false;
+    }
+    for(auto &[stack, count] : stacks) stream << stack << " " << count << "\n";
+    if(auto count = dropped.load()) stream << "interpreter;[dropped] " << count << "\n";
+    return true;
+}
@@ -0,0 +1,73 @@
+/**
+ * @file profiler.hpp
+ * @brief JIT でコンパイルした機械語の実行時間をサンプリングで測る
+ */
+#ifndef PROFILER_HPP
+#define PROFILER_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <ctime>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <signal.h>
+
+#include "llvm/ExecutionEngine/JITEventListener.h"
+
+/**
+ * @brief `--profile` で，一定の CPU 時間ごとに実行中のアドレスを記録し，文と行ごとに集計するクラス．
+ *
+ * メインスレッドの CPU 時間のタイマーで `SIGPROF` を受け，割り込まれたアドレスを固定長の配列に書く（`handle()`）．
+ * シグナルハンドラではメモリを確保できないので，アドレスの解決は後で行う（`resolve_samples()`）．
+ *
+ * JIT に読み込まれた関数は，アドレスの範囲と DWARF の行番号表を記録しておく（`notifyObjectLoaded()`）．
+ * 文の機械語は実行し終えると解放され，同じアドレスに次の文が読み込まれるので，
+ * 解放される直前（`notifyFreeingObject()`）にそれまでのサンプルを解決する．
+ *
+ * 結果はフレームグラフの folded stacks 形式で，1 行が `interpreter;m<N>;f<N>;<ファイル>:<行> <サンプル数>`．
+ * JIT の機械語の外（コンパイルなど）のサンプルは `interpreter;[native]` にまとめる．
+ */
+class Profiler : public llvm::JITEventListener {
+    //! JIT に読み込まれた関数
+    struct Function {
+        //! 機械語の終わりのアドレス（含まない）
+        std::uint64_t end;
+        //! 読み込んだオブジェクトファイル（解放されるときに消す）
+        ObjectKey key;
+        std::string name;
+        //! ソースファイルの名前（デバッグ情報が無ければ空）
+        std::string file;
+        //! 命令のアドレスと，その命令を生成した行（アドレスの昇順）
+        std::vector<std::pair<std::uint64_t, std::uint32_t>> lines;
+    };
+    //! 開始アドレスから，そこに読み込まれている関数
+    std::map<std::uint64_t, Function> functions;
+    //! 割り込まれたアドレス（`handle()` が書き，`resolve_samples()` が読む）
+    std::vector<std::uintptr_t> samples;
+    std::atomic<std::size_t> sample_count;
+    //! `samples` が一杯で捨てたサンプルの数
+    std::atomic<std::uint64_t> dropped;
+    //! 解決したサンプルの数（フレームを `;` でつないだものから）
+    std::map<std::string, std::uint64_t> stacks;
+    timer_t timer;
+    bool running;
+    static void handle(int, siginfo_t *, void *);
+    std::string stack(std::uintptr_t) const;
+    void resolve_samples();
+public:
+    Profiler();
+    ~Profiler();
+    Profiler(const Profiler &) = delete;
+    Profiler &operator=(const Profiler &) = delete;
+    bool start();
+    void stop();
+    bool write(const std::string &);
+    void notifyObjectLoaded(ObjectKey, const llvm::object::ObjectFile &, const llvm::RuntimeDyld::LoadedObjectInfo &) override;
+    void notifyFreeingObject(ObjectKey) override;
+};
+
+#endif
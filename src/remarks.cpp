@@ -0,0 +1,127 @@
+/**
+ * @file remarks.cpp
+ */
+#include "remarks.hpp"
+
+#include <iostream>
+
+#include "llvm/IR/DiagnosticHandler.h"
+#include "llvm/IR/Function.h"
+#include "llvm/Remarks/RemarkSerializer.h"
+
+/**
+ * @brief 最適化のリマークを `Remarks` に渡す診断のハンドラ．
+ *
+ * パスは，ここで有効と答えた種類のリマークだけを生成する．
+ * ただし命令数の増減（`size-info`）と命令の内訳（`asm-printer`）の分析は関数全体のものでソースコードに戻せないので，捨てる．
+ * リマーク以外の診断（警告など）は扱わず，LLVM の既定の出力に任せる．
+ */
+//! 関数全体についての分析で，ソースコードに戻せないリマークを出すパスか
+static bool is_whole_function_pass(llvm::StringRef pass){
+    return pass == "size-info" || pass == "asm-printer";
+}
+
+class RemarkHandler : public llvm::DiagnosticHandler {
+    Remarks &remarks;
+public:
+    explicit RemarkHandler(Remarks &remarks): remarks(remarks) {}
+    bool handleDiagnostics(const llvm::DiagnosticInfo &info) override {
+        auto remark = llvm::dyn_cast<llvm::DiagnosticInfoOptimizationBase>(&info);
+        if(!remark || !(remark->isPassed() || remark->isMissed() || remark->isAnalysis())) return false;
+        if(is_whole_function_pass(remark->getPassName())) return true;
+        auto &kinds = remarks.get_kinds();
+        if(remark->isPassed() ? !kinds.passed : remark->isMissed() ? !kinds.missed : !kinds.analysis) return true;
+        remarks.emit(*remark);
+        return true;
+    }
+    bool isAnalysisRemarkEnabled(llvm::StringRef pass) const override {
+        return remarks.get_kinds().analysis && !is_whole_function_pass(pass);
+    }
+    bool isMissedOptRemarkEnabled(llvm::StringRef) const override { return remarks.get_kinds().missed; }
+    bool isPassedOptRemarkEnabled(llvm::StringRef) const override { return remarks.get_kinds().passed; }
+    bool isAnyRemarkEnabled() const override { return remarks.get_kinds().any(); }
+};
+
+/**
+ * @brief コンストラクタ
+ * @param source ソースコード（`Lexer::get_log()`．リマークを報告するときに切り出す）
+ */
+Remarks::Remarks(option::RemarkKinds kinds, const std::vector<std::string> &source): kinds(kinds), source(source) {}
+
+/**
+ * @brief リマークを `path` にも YAML で書き出す．
+ * @retval false 書き出せなかった（理由を標準エラー出力に出力済み）
+ */
+bool Remarks::open_yaml(const std::string &path){
+    std::error_code error_code;
+    yaml_stream = std::make_unique<llvm::raw_fd_ostream>(path, error_code);
+    if(error_code){
+        std::cerr << "cannot write the remarks: " << error_code.message() << std::endl;
+        yaml_stream.reset();
+        return false;
+    }
+    auto serializer = llvm::remarks::createRemarkSerializer(
+        llvm::remarks::Format::YAML,
+        llvm::remarks::SerializerMode::Separate,
+        *yaml_stream
+    );
+    if(!serializer){
+        llvm::logAllUnhandledErrors(serializer.takeError(), llvm::errs(), "cannot write the remarks: ");
+        return false;
+    }
+    remark_streamer = std::make_unique<llvm::remarks::RemarkStreamer>(std::move(serializer.get()));
+    llvm_remark_streamer = std::make_unique<llvm::LLVMRemarkStreamer>(*remark_streamer);
+    return true;
+}
+
+/**
+ * @brief `context` のリマークをこのオブジェクトに渡すようにする．
+ *
+ * 文ごとのモジュールでは `llvm::LLVMContext` が取り替えられるので，モジュールを作るたびに呼ぶ（`Context::next_module()`）．
+ */
+void Remarks::attach(llvm::LLVMContext &context){
+    context.setDiagnosticHandler(std::make_unique<RemarkHandler>(*this));
+}
+
+/**
+ * @brief コンパイルした式や文の範囲を記録する（`Context::set_location()`）．
+ *
+ * 同じ位置で始まる範囲が複数あれば（`x = a` とその左辺の `x` など），最も長いものを残す．
+ */
+void Remarks::add_range(const pos::Range &range){
+    auto [line, column] = range.get_start().into_inner();
+    auto [found, inserted] = ranges.try_emplace({line + 1, column + 1}, range.get_start(), range.get_end());
+    if(!inserted && found->second.get_end().into_inner() < range.get_end().into_inner()){
+        found->second = pos::Range(range.get_start(), range.get_end());
+    }
+}
+
+const option::RemarkKinds &Remarks::get_kinds() const {
+    return kinds;
+}
+
+/**
+ * @brief リマークを報告する．
+ *
+ * 1 行目は種類・パス・リマークの名前・内容と位置．位置が記録した範囲の開始位置なら，続けてその範囲を切り出して出力する．
+ * 位置が無いか関数の宣言の行だけなら（デバッグ情報の無い命令や関数全体のリマーク），関数名を出力する．
+ */
+void Remarks::emit(const llvm::DiagnosticInfoOptimizationBase &remark){
+    if(llvm_remark_streamer) llvm_remark_streamer->emit(remark);
+    std::cerr
+        << "remark: " << (remark.isPassed() ? "passed" : remark.isMissed() ? "missed" : "analysis") << " "
+        << remark.getPassName().str() << "/" << remark.getRemarkName().str() << ": "
+        << remark.getMsg();
+    if(!remark.isLocationAvailable()){
+        std::cerr << " (in " << remark.getFunction().getName().str() << ")" << std::endl;
+        return;
+    }
+    auto location = remark.getLocation();
+    auto found = ranges.find({location.getLine(), location.getColumn()});
+    if(found == ranges.end()){
+        std::cerr << " (in " << remark.getFunction().getName().str() << ", line " << location.getLine() << ")" << std::endl;
+        return;
+    }
+    std::cerr << " (at " << found->second << ")" << std::endl;
+    found->second.eprint(source);
+}
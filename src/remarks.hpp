@@ -0,0 +1,53 @@
+/**
+ * @file remarks.hpp
+ * @brief 最適化のリマークをソースコードの位置と共に報告する
+ */
+#ifndef REMARKS_HPP
+#define REMARKS_HPP
+
+#include <cstddef>
+#include <map>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "option.hpp"
+#include "pos.hpp"
+
+#include "llvm/IR/DiagnosticInfo.h"
+#include "llvm/IR/LLVMContext.h"
+#include "llvm/IR/LLVMRemarkStreamer.h"
+#include "llvm/Remarks/RemarkStreamer.h"
+#include "llvm/Support/raw_ostream.h"
+
+/**
+ * @brief `--remarks` で，最適化のパスが出すリマーク（ループをベクトル化できなかった理由など）を集めて報告するクラス．
+ *
+ * モジュールを作る `llvm::LLVMContext` ごとに診断のハンドラを設定し（`attach()`），
+ * 指定された種類のリマークだけをパスに生成させる．
+ * リマークの位置は命令のデバッグ情報の行と列なので，コンパイルするときに記録した式や文の範囲（`add_range()`）に戻し，
+ * `pos::Range::eprint()` でソースコードを切り出して標準エラー出力に出力する．
+ * `--remarks-yaml` なら，LLVM の YAML の形式でも書き出す（`open_yaml()`）．
+ */
+class Remarks {
+    option::RemarkKinds kinds;
+    //! ソースコード（`Lexer::get_log()`）
+    const std::vector<std::string> &source;
+    //! 開始位置（1-indexed の行と列）から，そこで始まる式や文の範囲
+    std::map<std::pair<std::size_t, std::size_t>, pos::Range> ranges;
+    std::unique_ptr<llvm::raw_fd_ostream> yaml_stream;
+    std::unique_ptr<llvm::remarks::RemarkStreamer> remark_streamer;
+    std::unique_ptr<llvm::LLVMRemarkStreamer> llvm_remark_streamer;
+public:
+    Remarks(option::RemarkKinds, const std::vector<std::string> &);
+    Remarks(const Remarks &) = delete;
+    Remarks &operator=(const Remarks &) = delete;
+    bool open_yaml(const std::string &);
+    void attach(llvm::LLVMContext &);
+    void add_range(const pos::Range &);
+    const option::RemarkKinds &get_kinds() const;
+    void emit(const llvm::DiagnosticInfoOptimizationBase &);
+};
+
+#endif
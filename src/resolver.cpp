@@ -0,0 +1,62 @@
+/**
+ * @file resolver.cpp
+ */
+#include "resolver.hpp"
+
+//! コンストラクタ．大域変数のスコープだけを持つ．
+Resolver::Resolver(): scopes(1), local_count(0), global_count(0) {}
+
+//! トップレベルの文を解決し始める．ローカル変数の番号は文ごとに 0 から振り直す．
+void Resolver::begin_sentence(){
+    local_count = 0;
+}
+
+//! 今のトップレベルの文で宣言したローカル変数の数
+unsigned Resolver::get_local_count() const {
+    return local_count;
+}
+
+//! ブロックや `if` `while` の節に入る
+void Resolver::enter_scope(){
+    scopes.emplace_back();
+}
+
+/**
+ * @brief ブロックや `if` `while` の節から出る．中で宣言した名前は見えなくなる．
+ * @return 中で宣言した名前
+ */
+std::vector<std::string> Resolver::leave_scope(){
+    std::vector<std::string> ret;
+    for(auto &[name, binding] : scopes.back()) ret.push_back(name);
+    scopes.pop_back();
+    return ret;
+}
+
+/**
+ * @brief 最も内側のスコープで名前を宣言し，新しい番号を割り当てる．
+ *
+ * 大域変数のスコープにいれば大域変数，そうでなければローカル変数になる．
+ * 同じスコープで同じ名前を宣言し直したら，以降はその新しい変数を指す．
+ */
+Binding Resolver::declare(const std::string &name){
+    Binding ret;
+    if(scopes.size() == 1){
+        ret = {Binding::Kind::Global, global_count++};
+    }else{
+        ret = {Binding::Kind::Local, local_count++};
+    }
+    scopes.back().insert_or_assign(name, ret);
+    return ret;
+}
+
+/**
+ * @brief 名前を内側のスコープから順に探す．
+ * @retval std::nullopt どのスコープでも宣言されていない
+ */
+std::optional<Binding> Resolver::find(const std::string &name) const {
+    for(auto scope = scopes.rbegin(); scope != scopes.rend(); ++scope){
+        auto found = scope->find(name);
+        if(found != scope->end()) return found->second;
+    }
+    return std::nullopt;
+}
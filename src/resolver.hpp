@@ -0,0 +1,59 @@
+/**
+ * @file resolver.hpp
+ * @brief 名前解決を行う
+ */
+#ifndef RESOLVER_HPP
+#define RESOLVER_HPP
+
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * @brief 名前解決の結果（識別子や宣言が指す変数）
+ */
+struct Binding {
+    enum class Kind {
+        //! まだ解決していない
+        Unresolved,
+        //! トップレベルの文の中のローカル変数
+        Local,
+        //! 大域変数
+        Global
+    };
+    Kind kind = Kind::Unresolved;
+    /**
+     * @brief 変数の番号
+     *
+     * ローカル変数ならトップレベルの文ごとの通し番号（ブロックが違えば同じ名前でも別の番号），
+     * 大域変数なら宣言の通し番号（`Context::globals` の添字）．
+     */
+    unsigned index = 0;
+};
+
+/**
+ * @brief 構文解析とコンパイルの間で，識別子が指す変数を決めるクラス．
+ *
+ * スコープの入れ子をスタックで持ち，各 `expression::Identifier` と `sentence::Declaration` に
+ * `Binding` を書き込む．コンパイルや評価では名前を引かずに `Binding::index` で変数を直接得る．
+ * 大域変数のスコープは文をまたいで残る．
+ */
+class Resolver {
+    //! 内側のスコープほど後ろ．先頭は大域変数のスコープ
+    std::vector<std::unordered_map<std::string, Binding>> scopes;
+    //! 今のトップレベルの文で宣言したローカル変数の数
+    unsigned local_count;
+    //! これまでに宣言した大域変数の数
+    unsigned global_count;
+public:
+    Resolver();
+    void begin_sentence();
+    unsigned get_local_count() const;
+    void enter_scope();
+    std::vector<std::string> leave_scope();
+    Binding declare(const std::string &);
+    std::optional<Binding> find(const std::string &) const;
+};
+
+#endif
@@ -0,0 +1,42 @@
+/**
+ * @file runtime.cpp
+ */
+#include "runtime.hpp"
+
+#include <csetjmp>
+#include <cstdlib>
+
+#include "error.hpp"
+
+namespace runtime {
+    //! 実行中の `call()` に戻る先（`call()` の外では `nullptr`）
+    static thread_local std::jmp_buf *return_point = nullptr;
+    //! 報告された 0 による除算の位置
+    static thread_local pos::Range division_position;
+
+    /**
+     * @brief コンパイルしたコードの引数も戻り値も無い関数を呼び出す．
+     *
+     * 実行時エラーが報告されたら，`function` の実行をそこで打ち切って例外を投げる．
+     * それまでに書き込んだ大域変数の値は残る．
+     * @throw error::DivisionByZero 0 で割った
+     */
+    void call(void (*function)()){
+        std::jmp_buf buffer;
+        auto *const previous = return_point;
+        return_point = &buffer;
+        if(setjmp(buffer)){
+            return_point = previous;
+            throw error::make<error::DivisionByZero>(std::move(division_position));
+        }
+        function();
+        return_point = previous;
+    }
+
+    //! 0 による除算を報告して `call()` に戻る（`DIVISION_BY_ZERO`）．
+    void division_by_zero(std::uint64_t start_line, std::uint64_t start_byte, std::uint64_t end_line, std::uint64_t end_byte){
+        if(!return_point) std::abort();
+        division_position = pos::Range(pos::Pos(start_line, start_byte), pos::Pos(end_line, end_byte));
+        std::longjmp(*return_point, 1);
+    }
+}
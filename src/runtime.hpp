@@ -0,0 +1,32 @@
+/**
+ * @file runtime.hpp
+ * @brief JIT でコンパイルしたコードから呼び出す実行時の関数
+ */
+#ifndef RUNTIME_HPP
+#define RUNTIME_HPP
+
+#include <cstdint>
+
+/**
+ * @brief JIT でコンパイルしたコードから呼び出す実行時の関数．
+ *
+ * 生成したコードは関数を名前で宣言して呼び出し，`JIT` がこのプロセスの関数をその名前で登録する．
+ * 実行ファイル（`--emit=exe`）では `add_entry_point()` が同じ名前の関数を定義する．
+ *
+ * 実行時エラーはコンパイルしたコードの中から C++ の例外では抜けられない（機械語に巻き戻しの情報が無い）．
+ * そこで `call()` が `setjmp()` しておき，エラーを報告する関数は `longjmp()` で `call()` に戻ってから例外を投げる．
+ * 間に挟まるのは生成したコードのフレームだけなので，デストラクタを飛ばすことは無い．
+ */
+namespace runtime {
+    /**
+     * @brief 0 による除算・剰余を報告する関数の名前．
+     *
+     * 引数は式の位置（`pos::Range`）の開始の行とバイト，終了の行とバイト（どれも 0-indexed の `i64`）．戻らない．
+     */
+    inline constexpr const char *DIVISION_BY_ZERO = "division_by_zero";
+
+    void call(void (*)());
+    [[noreturn]] void division_by_zero(std::uint64_t, std::uint64_t, std::uint64_t, std::uint64_t);
+}
+
+#endif
@@ -4,6 +4,10 @@
 #include "sentence.hpp"
 
 #include <sstream>
+#include "error.hpp"
+#include "trace.hpp"
+
+#include "llvm/IR/MDBuilder.h"
 
 namespace sentence {
     Sentence::~Sentence() = default;
@@ -33,82 +37,652 @@ namespace sentence {
     /**
      * @brief コンストラクタ
      * @param condition 条件
+     * @param likelihood 条件のヒント
      * @param if_clause if 節
      * @param else_clause else 節（空なら nullptr）
      */
     If::If(
         std::unique_ptr<expression::Expression> condition,
+        Likelihood likelihood,
         std::unique_ptr<Sentence> if_clause,
         std::unique_ptr<Sentence> else_clause
     ):
         condition(std::move(condition)),
+        likelihood(likelihood),
         if_clause(std::move(if_clause)),
         else_clause(std::move(else_clause)) {}
     /**
      * @brief コンストラクタ
      * @param condition 条件
+     * @param likelihood 条件のヒント
      * @param sentence 中身
      */
     While::While(
         std::unique_ptr<expression::Expression> condition,
+        Likelihood likelihood,
         std::unique_ptr<Sentence> sentence
     ):
         condition(std::move(condition)),
+        likelihood(likelihood),
         sentence(std::move(sentence)) {}
 
+    /**
+     * @brief トップレベルの文の名前を解決する．
+     *
+     * 構文解析の直後，コンパイルや評価の前に 1 度だけ呼ぶ．
+     * 結果は各 `expression::Identifier` と `Declaration` に残るので，同じ文を何度コンパイルしても引き直さない．
+     * @throw error::UndefinedVariable 宣言されていない変数を参照した
+     */
+    void Sentence::resolve(Resolver &resolver){
+        resolver.begin_sentence();
+        resolve_local(resolver);
+        local_count = resolver.get_local_count();
+    }
+    void Expression::resolve_local(Resolver &resolver){
+        if(expression) expression->resolve(resolver);
+    }
+    /**
+     * @brief 宣言の名前を解決する．
+     *
+     * 初期化の式では宣言する変数自身はまだ見えない（外側の同じ名前を指す）．
+     * 大域変数を宣言し直したら，隠される前の大域変数を `superseded` に覚えておく．
+     */
+    void Declaration::resolve_local(Resolver &resolver){
+        if(expression) expression->resolve(resolver);
+        auto previous = resolver.find(name);
+        binding = resolver.declare(name);
+        if(binding.kind == Binding::Kind::Global && previous) superseded = previous->index;
+    }
+    void Block::resolve_local(Resolver &resolver){
+        resolver.enter_scope();
+        for(auto &sentence : sentences) sentence->resolve_local(resolver);
+        declared_names = resolver.leave_scope();
+    }
+    //! 各節はブロックでなくても独自のスコープを持つ．
+    void If::resolve_local(Resolver &resolver){
+        condition->resolve(resolver);
+        resolver.enter_scope();
+        if_clause->resolve_local(resolver);
+        resolver.leave_scope();
+        if(else_clause){
+            resolver.enter_scope();
+            else_clause->resolve_local(resolver);
+            resolver.leave_scope();
+        }
+    }
+    void While::resolve_local(Resolver &resolver){
+        condition->resolve(resolver);
+        resolver.enter_scope();
+        sentence->resolve_local(resolver);
+        resolver.leave_scope();
+    }
 
-    static llvm::Function *create_function(Context &context){
+    static llvm::Function *create_function(Context &context, const std::string &name){
         llvm::Type *void_type = llvm::Type::getVoidTy(*context.context.getContext());
         llvm::FunctionType *function_type = llvm::FunctionType::get(void_type, {}, false);
-        return llvm::Function::Create(function_type, llvm::Function::ExternalLinkage, context.function_name(), *context.module);
+        return llvm::Function::Create(function_type, llvm::Function::ExternalLinkage, name, *context.module);
     }
 
     /**
-     * @brief コンパイル
-     * 
-     * 今は `virtual` ではないが，関数定義ができるようになったら，関数の型とかが変わるので変える必要がある
+     * @brief 宣言された変数の型を決める．
+     * @param initializer 初期化の式の型（無ければ `nullptr`）
+     * @throw error::TypeMismatch 型名と初期化の式の型が合わない
+     * @throw error::NoTypeInDeclaration 型名も初期化の式も無い
+     */
+    static std::shared_ptr<value::Type> declared_type(
+        const std::unique_ptr<type::Type> &type,
+        const std::unique_ptr<expression::Expression> &expression,
+        const std::shared_ptr<value::Type> &initializer,
+        pos::Range &pos
+    ){
+        if(!initializer){
+            if(!type) throw error::make<error::NoTypeInDeclaration>(pos.clone());
+            return type->into();
+        }
+        if(type){
+            auto declared = type->into();
+            if(declared->is_integer() != initializer->is_integer() || declared->is_boolean() != initializer->is_boolean()){
+                throw error::make<error::TypeMismatch>(expression->pos.clone());
+            }
+        }
+        return initializer;
+    }
+    /**
+     * @brief 文 1 つをモジュール `m<N>` にコンパイルする．
+     *
+     * 文は関数 `f<N>` になる．ただし，定数で初期化する宣言のように実行時にすることが何も残らなければ
+     * `f<N>` は作らず，大域変数だけを持つデータのみのモジュールを返す．
+     * 呼び出す側は `f<N>` があるか（`llvm::Module::getFunction()`）を見て実行するか決める．
+     * `Context::counters` や `Context::pgo_instrumentation` があれば文の入口で実行回数を数えるので，`f<N>` は常に作られる．
+     * `Context::pgo_profile` に文の実行回数があれば，それを `f<N>` の実行回数にする．
+     * `Context::debug_info` なら `f<N>` の `DISubprogram` を作り，文や式の位置を命令に付ける．
      */
-    llvm::orc::ThreadSafeModule Sentence::compile(Context &context){
+    std::unique_ptr<llvm::Module> Sentence::compile_module(Context &context){
         context.next_module();
-        llvm::Function *function = create_function(context);
+        context.set_source(pos);
+        llvm::Function *function = create_function(context, context.function_name());
+        context.start_function(function, pos);
         llvm::BasicBlock *basic_block = llvm::BasicBlock::Create(*context.context.getContext(), "", function);
-        context.builder.SetInsertPoint(basic_block);
-        std::unordered_map<std::string, value::Value> local_variables;
+        context.builder->SetInsertPoint(basic_block);
+        context.ssa.clear();
+        context.ssa.seal(basic_block);
+        context.count(pos.clone());
+        context.profile_entry(function);
+        std::vector<expression::Variable> local_variables(local_count);
         compile_global(context, local_variables);
-        context.builder.CreateRetVoid();
+        context.builder->CreateRetVoid();
+        auto module = context.take_module();
+        if(function->size() == 1 && function->getEntryBlock().size() == 1){
+            context.builder->ClearInsertionPoint();
+            function->eraseFromParent();
+        }
+        return module;
+    }
+    /**
+     * @brief プログラム全体を 1 つのモジュール `m0` にコンパイルする．
+     *
+     * 文ごとに `f<N>` を作る代わりに，すべての文を順に 1 つの関数 `f0` の中にコンパイルする．
+     * 大域変数 `g<N>` は `InternalLinkage` になるので，最適化で定数伝播やレジスタへの昇格ができる．
+     * `--time-trace` には文ごとに `Sentence` の区間を記録する．
+     * @param sentences トップレベルの文（実行順）
+     */
+    llvm::orc::ThreadSafeModule Sentence::compile_program(Context &context, std::vector<std::unique_ptr<Sentence>> &sentences){
+        context.program_module();
+        llvm::Function *function = create_function(context, context.function_name(0));
+        context.start_function(function, pos::Range());
+        llvm::BasicBlock *basic_block = llvm::BasicBlock::Create(*context.context.getContext(), "", function);
+        context.builder->SetInsertPoint(basic_block);
+        context.ssa.clear();
+        context.ssa.seal(basic_block);
+        for(auto &sentence : sentences){
+            llvm::TimeTraceScope scope("Sentence", [&](){ return trace::describe(sentence->pos); });
+            context.next_sentence();
+            context.set_source(sentence->pos);
+            context.set_location(sentence->pos);
+            context.count(sentence->pos.clone());
+            context.profile_entry(function);
+            std::vector<expression::Variable> local_variables(sentence->local_count);
+            sentence->compile_global(context, local_variables);
+        }
+        context.builder->CreateRetVoid();
         return llvm::orc::ThreadSafeModule(context.take_module(), context.context);
     }
-    void Expression::compile_global(Context &context, std::unordered_map<std::string, value::Value> &local_variables){
-        expression->compile(context, local_variables);
+    /**
+     * @brief トップレベルの文をコンパイルする．
+     *
+     * 宣言以外はブロックの中と同じ．
+     */
+    void Sentence::compile_global(Context &context, std::vector<expression::Variable> &local_variables){
+        compile_local(context, local_variables);
     }
-    void Declaration::compile_global(Context &context, std::unordered_map<std::string, value::Value> &local_variables){
+    void Expression::compile_local(Context &context, std::vector<expression::Variable> &local_variables){
+        if(expression) expression->compile(context, local_variables);
+    }
+    /**
+     * @brief トップレベルの宣言をコンパイルする．
+     *
+     * 大域変数 `g<番号>` を定義して初期値を書き込み，`Context::globals` の宣言の番号の位置に登録する．
+     * 初期値が定数に畳み込めたら，`store` はせずに大域変数の静的な初期値にし，
+     * その値も登録する（`Context::load_global()` を参照）．
+     */
+    void Declaration::compile_global(Context &context, std::vector<expression::Variable> &local_variables){
         value::Value value;
+        if(expression) value = expression->compile(context, local_variables);
+        auto value_type = declared_type(type, expression, value.type, pos);
+        llvm::Constant *initializer = value_type->default_value(*context.context.getContext());
+        std::optional<std::int32_t> initial_value = 0;
         if(expression){
-            value = expression->compile(context, local_variables);
-        }else if(type){
-            value.type = type->into();
+            if(auto constant = llvm::dyn_cast<llvm::ConstantInt>(value.llvm_value)){
+                initializer = constant;
+                initial_value = static_cast<std::int32_t>(constant->getSExtValue());
+            }else{
+                initial_value = std::nullopt;
+            }
         }
         auto variable = new llvm::GlobalVariable(
             context.get_module(),
-            value.type->llvm_type(*context.context.getContext()),
+            value_type->llvm_type(*context.context.getContext()),
             false,
-            llvm::GlobalValue::ExternalLinkage,
-            value.type->default_value(*context.context.getContext()),
+            context.linkage,
+            initializer,
             context.global_variable_name()
         );
-        if(expression){
-            context.builder.CreateStore(value.llvm_value, variable);
+        context.describe_global(variable, name, *value_type, pos);
+        context.set_location(pos);
+        if(!initial_value){
+            context.store_global(context.get_module_number(), *value_type, value.llvm_value);
+        }
+        context.define_global(
+            binding.index,
+            DeclaredGlobal{context.get_module_number(), std::move(value_type), initial_value, 0, std::nullopt, false}
+        );
+        if(superseded) context.retire_global(superseded.value());
+        context.invalidate_available(name);
+    }
+    /**
+     * @brief ブロック中の宣言をコンパイルする．
+     *
+     * `alloca` は使わず，`ssa::Builder` の新しい変数にして宣言の位置で初期値を代入する．
+     * 繰り返しの中の宣言は毎回初期化される．
+     */
+    void Declaration::compile_local(Context &context, std::vector<expression::Variable> &local_variables){
+        value::Value value;
+        if(expression) value = expression->compile(context, local_variables);
+        auto value_type = declared_type(type, expression, value.type, pos);
+        auto &llvm_context = *context.context.getContext();
+        auto variable = context.ssa.new_variable(value_type->llvm_type(llvm_context), name);
+        context.ssa.write(variable, context.builder->GetInsertBlock(), expression ? value.llvm_value : value_type->default_value(llvm_context));
+        local_variables[binding.index] = expression::Variable{variable, std::move(value_type)};
+        context.invalidate_available(name);
+    }
+    /**
+     * @brief ブロックをコンパイルする．
+     *
+     * 中で宣言された変数はブロックを出ると見えなくなるので，それを読む計算済みの式も捨てる．
+     * `Context::counters` があれば各文の入口で実行回数を数える．
+     */
+    void Block::compile_local(Context &context, std::vector<expression::Variable> &local_variables){
+        for(auto &sentence : sentences){
+            context.set_location(sentence->pos);
+            context.count(sentence->pos.clone());
+            sentence->compile_local(context, local_variables);
+        }
+        for(auto &name : declared_names) context.invalidate_available(name);
+    }
+    //! 条件式をコンパイルして，真偽値であることを確かめる
+    static llvm::Value *compile_condition(
+        Context &context,
+        std::vector<expression::Variable> &local_variables,
+        std::unique_ptr<expression::Expression> &condition
+    ){
+        auto ret = condition->compile(context, local_variables);
+        if(!ret.type->is_boolean()) throw error::make<error::TypeMismatch>(condition->pos.clone());
+        return ret.llvm_value;
+    }
+    /**
+     * @brief 条件分岐の `!prof` メタデータ（`likely` なら真の側に 2000:1 で偏らせる）
+     *
+     * 明示したヒントを優先し，ヒントが無ければプロファイルの重み（`Context::profile_branch()`）を使う．
+     * @param profile プロファイルの重み（無ければ `nullptr`）
+     * @retval nullptr ヒントもプロファイルも無し
+     */
+    static llvm::MDNode *branch_weights(Context &context, Likelihood likelihood, llvm::MDNode *profile){
+        constexpr std::uint32_t likely_weight = 2000, unlikely_weight = 1;
+        llvm::MDBuilder md_builder(*context.context.getContext());
+        switch(likelihood){
+            case Likelihood::None: return profile;
+            case Likelihood::Likely: return md_builder.createBranchWeights(likely_weight, unlikely_weight);
+            case Likelihood::Unlikely: return md_builder.createBranchWeights(unlikely_weight, likely_weight);
+        }
+        return nullptr;
+    }
+    /**
+     * @brief 識別子への単純な代入 `x = a;` だけからなる文（`{ x = a; }` も含む）なら，その式を返す．
+     * @retval nullptr そうではない
+     */
+    expression::BinaryOperation *Sentence::simple_assignment(){ return nullptr; }
+    expression::BinaryOperation *Expression::simple_assignment(){
+        return expression ? expression->simple_assignment() : nullptr;
+    }
+    expression::BinaryOperation *Block::simple_assignment(){
+        return sentences.size() == 1 ? sentences.front()->simple_assignment() : nullptr;
+    }
+    /**
+     * @brief if 文をコンパイルする．
+     *
+     * `if.then`，（あれば）`if.else`，`if.end` の基本ブロックを作る．
+     * 節の中で書き換えられたローカル変数は `if.end` の `phi` で合流する．
+     * `likely` `unlikely` は分岐の `!prof` になる．
+     *
+     * ヒントが無く，`Context::branchless` で各節が同じ変数への単純な代入なら，
+     * 分岐せずに `select` にする（`expression::BinaryOperation::compile_select()`）．
+     *
+     * `Context::counters` があれば各節の入口で実行回数を数える．`select` にした場合は分岐しないので，
+     * 条件の値（`else` の節なら否定）を 64 ビットに広げて加える．
+     * プロファイルの重みは，分岐にも `select` にも付ける．
+     */
+    void If::compile_local(Context &context, std::vector<expression::Variable> &local_variables){
+        auto &llvm_context = *context.context.getContext();
+        auto condition_value = compile_condition(context, local_variables, condition);
+        auto profile = context.profile_branch(condition_value);
+        if(context.branchless && likelihood == Likelihood::None){
+            auto then_assignment = if_clause->simple_assignment();
+            auto else_assignment = else_clause ? else_clause->simple_assignment() : nullptr;
+            if(then_assignment && (!else_clause || else_assignment)){
+                if(then_assignment->compile_select(context, local_variables, condition_value, else_assignment, profile)){
+                    if(context.counters){
+                        context.count(if_clause->pos.clone(), context.builder->CreateZExt(condition_value, context.builder->getInt64Ty()));
+                        if(else_clause){
+                            auto not_taken = context.builder->CreateZExt(context.builder->CreateNot(condition_value), context.builder->getInt64Ty());
+                            context.count(else_clause->pos.clone(), not_taken);
+                        }
+                    }
+                    return;
+                }
+            }
+        }
+        auto function = context.builder->GetInsertBlock()->getParent();
+        auto then_block = llvm::BasicBlock::Create(llvm_context, "if.then", function);
+        auto else_block = else_clause ? llvm::BasicBlock::Create(llvm_context, "if.else", function) : nullptr;
+        auto end_block = llvm::BasicBlock::Create(llvm_context, "if.end", function);
+        context.set_location(pos);
+        context.builder->CreateCondBr(condition_value, then_block, else_block ? else_block : end_block, branch_weights(context, likelihood, profile));
+        context.ssa.seal(then_block);
+        if(else_block) context.ssa.seal(else_block);
+        context.builder->SetInsertPoint(then_block);
+        context.count(if_clause->pos.clone());
+        if_clause->compile_local(context, local_variables);
+        context.builder->CreateBr(end_block);
+        if(else_clause){
+            context.builder->SetInsertPoint(else_block);
+            context.count(else_clause->pos.clone());
+            else_clause->compile_local(context, local_variables);
+            context.builder->CreateBr(end_block);
+        }
+        context.ssa.seal(end_block);
+        context.builder->SetInsertPoint(end_block);
+    }
+    /**
+     * @brief ループの `llvm.loop` メタデータを作る．
+     *
+     * どのループにも `llvm.loop.mustprogress` を付ける（副作用の無い無限ループは未定義動作とする）．
+     * `likely` なループは熱いとみなして展開とベクトル化を促し，`unlikely` なループは展開しない．
+     */
+    static llvm::MDNode *loop_metadata(Context &context, Likelihood likelihood){
+        auto &llvm_context = *context.context.getContext();
+        auto hint = [&](const char *name, std::optional<bool> value = std::nullopt) -> llvm::Metadata * {
+            llvm::SmallVector<llvm::Metadata *, 2> operands{llvm::MDString::get(llvm_context, name)};
+            if(value) operands.push_back(llvm::ConstantAsMetadata::get(context.builder->getInt1(value.value())));
+            return llvm::MDNode::get(llvm_context, operands);
+        };
+        llvm::SmallVector<llvm::Metadata *, 4> operands{nullptr, hint("llvm.loop.mustprogress")};
+        if(likelihood == Likelihood::Likely){
+            operands.push_back(hint("llvm.loop.unroll.enable"));
+            operands.push_back(hint("llvm.loop.vectorize.enable", true));
+        }else if(likelihood == Likelihood::Unlikely){
+            operands.push_back(hint("llvm.loop.unroll.disable"));
+        }
+        auto ret = llvm::MDNode::getDistinct(llvm_context, operands);
+        ret->replaceOperandWith(0, ret);
+        return ret;
+    }
+    /**
+     * @brief while 文をコンパイルする．
+     *
+     * `while.cond` で条件を調べ，`while.body` の最後から `while.cond` に戻る．
+     * `while.cond` は戻りの分岐を作るまで封印しないので，ループ中で書き換えられるローカル変数の `phi` はそこに置かれる．
+     *
+     * 最も外側のループでは，中で参照された大域変数をループの直前で読み込んで SSA の変数に昇格し，
+     * 書き込まれたものだけを `while.end` で書き戻す（`Context::promote_global()`）．
+     * そのため `while (i < n) { s += i; i += 1; }` はレジスタだけのループになる．
+     * 戻りの分岐に `llvm.loop` メタデータを付け，`likely` `unlikely` は条件の分岐の `!prof` になる．
+     * `Context::counters` があれば，戻りの分岐の直前で繰り返しの回数を while 文の位置のカウンタで数える．
+     */
+    void While::compile_local(Context &context, std::vector<expression::Variable> &local_variables){
+        auto &llvm_context = *context.context.getContext();
+        auto function = context.builder->GetInsertBlock()->getParent();
+        auto condition_block = llvm::BasicBlock::Create(llvm_context, "while.cond", function);
+        auto body_block = llvm::BasicBlock::Create(llvm_context, "while.body", function);
+        auto end_block = llvm::BasicBlock::Create(llvm_context, "while.end", function);
+        context.builder->CreateBr(condition_block);
+        bool outermost = !context.loop_preheader;
+        if(outermost) context.loop_preheader = context.builder->GetInsertBlock();
+        context.builder->SetInsertPoint(condition_block);
+        auto condition_value = compile_condition(context, local_variables, condition);
+        context.set_location(pos);
+        auto profile = context.profile_branch(condition_value);
+        context.builder->CreateCondBr(condition_value, body_block, end_block, branch_weights(context, likelihood, profile));
+        context.ssa.seal(body_block);
+        context.ssa.seal(end_block);
+        context.builder->SetInsertPoint(body_block);
+        sentence->compile_local(context, local_variables);
+        context.set_location(pos);
+        context.count(pos.clone());
+        auto latch = context.builder->CreateBr(condition_block);
+        latch->setMetadata(llvm::LLVMContext::MD_loop, loop_metadata(context, likelihood));
+        context.ssa.seal(condition_block);
+        context.builder->SetInsertPoint(end_block);
+        if(outermost) context.write_back_promoted_globals();
+    }
+
+    /**
+     * @brief トップレベルの文としてバイトコードにコンパイルする．
+     *
+     * `compile()` と同じく文の番号を 1 つ進めるので，この文で宣言される大域変数は `g[番号]` になる．
+     */
+    void Sentence::compile_bytecode(Context &context, bytecode::Builder &builder){
+        context.next_sentence();
+        std::vector<expression::Register> local_registers(local_count);
+        compile_bytecode_global(context, builder, local_registers);
+    }
+    /**
+     * @brief トップレベルの文をバイトコードにコンパイルする．
+     *
+     * 宣言以外はブロックの中と同じ．
+     */
+    void Sentence::compile_bytecode_global(Context &context, bytecode::Builder &builder, std::vector<expression::Register> &local_registers){
+        compile_bytecode_local(context, builder, local_registers);
+    }
+    void Expression::compile_bytecode_local(Context &context, bytecode::Builder &builder, std::vector<expression::Register> &local_registers){
+        if(expression) expression->compile_bytecode(context, builder, local_registers);
+    }
+    /**
+     * @brief トップレベルの宣言をバイトコードにコンパイルする．
+     *
+     * 大域変数 `g[番号]` に初期値を書き込み，`Context::globals` に登録する．
+     * 初期値が無ければ何もしない（`VM` の大域変数は 0 で初期化されている）．
+     */
+    void Declaration::compile_bytecode_global(Context &context, bytecode::Builder &builder, std::vector<expression::Register> &local_registers){
+        std::optional<expression::Register> initializer;
+        if(expression) initializer = expression->compile_bytecode(context, builder, local_registers);
+        auto value_type = declared_type(type, expression, initializer ? initializer->type : nullptr, pos);
+        auto number = static_cast<std::int32_t>(context.get_module_number());
+        builder.use_global(number);
+        if(initializer) builder.emit(bytecode::Opcode::StoreGlobal, number, initializer->index);
+        context.define_global(
+            binding.index,
+            DeclaredGlobal{context.get_module_number(), std::move(value_type), std::nullopt, 0, std::nullopt, false}
+        );
+    }
+    /**
+     * @brief ブロック中の宣言をバイトコードにコンパイルする．
+     *
+     * 新しいレジスタをローカル変数に割り当てる．
+     */
+    void Declaration::compile_bytecode_local(Context &context, bytecode::Builder &builder, std::vector<expression::Register> &local_registers){
+        std::optional<expression::Register> initializer;
+        if(expression) initializer = expression->compile_bytecode(context, builder, local_registers);
+        auto value_type = declared_type(type, expression, initializer ? initializer->type : nullptr, pos);
+        auto variable = builder.new_register();
+        if(initializer) builder.emit(bytecode::Opcode::Move, variable, initializer->index);
+        else builder.emit(bytecode::Opcode::Constant, variable, 0);
+        local_registers[binding.index] = expression::Register{variable, std::move(value_type)};
+    }
+    /**
+     * @brief ブロックをバイトコードにコンパイルする．
+     *
+     * 中で宣言された変数は名前解決で別の番号になっているので，外側の変数を隠す処理は要らない．
+     */
+    void Block::compile_bytecode_local(Context &context, bytecode::Builder &builder, std::vector<expression::Register> &local_registers){
+        for(auto &sentence : sentences){
+            sentence->compile_bytecode_local(context, builder, local_registers);
+        }
+    }
+    //! 条件式をコンパイルして，真偽値であることを確かめる
+    static expression::Register compile_condition(
+        Context &context,
+        bytecode::Builder &builder,
+        std::vector<expression::Register> &local_registers,
+        std::unique_ptr<expression::Expression> &condition
+    ){
+        auto ret = condition->compile_bytecode(context, builder, local_registers);
+        if(!ret.type->is_boolean()) throw error::make<error::TypeMismatch>(condition->pos.clone());
+        return ret;
+    }
+    /**
+     * @brief if 文をバイトコードにコンパイルする．
+     *
+     * 条件が比較なら比較と分岐のスーパー命令になる．
+     */
+    void If::compile_bytecode_local(Context &context, bytecode::Builder &builder, std::vector<expression::Register> &local_registers){
+        auto condition_register = compile_condition(context, builder, local_registers, condition);
+        auto to_else = builder.emit_jump_unless(condition_register.index);
+        if_clause->compile_bytecode_local(context, builder, local_registers);
+        if(else_clause){
+            auto to_end = builder.emit_jump();
+            builder.set_target(to_else);
+            else_clause->compile_bytecode_local(context, builder, local_registers);
+            builder.set_target(to_end);
+        }else{
+            builder.set_target(to_else);
         }
-        context.global_variables.insert_or_assign(
-            name,
-            std::make_pair(context.get_module_number(), std::move(value.type))
+    }
+    /**
+     * @brief while 文をバイトコードにコンパイルする．
+     *
+     * 条件が比較なら比較と分岐のスーパー命令になる．
+     */
+    void While::compile_bytecode_local(Context &context, bytecode::Builder &builder, std::vector<expression::Register> &local_registers){
+        auto start = builder.label();
+        auto condition_register = compile_condition(context, builder, local_registers, condition);
+        auto to_end = builder.emit_jump_unless(condition_register.index);
+        sentence->compile_bytecode_local(context, builder, local_registers);
+        builder.emit(bytecode::Opcode::Jump, static_cast<std::int32_t>(start));
+        builder.set_target(to_end);
+    }
+
+    /**
+     * @brief トップレベルの文として，コンパイルせずに直接評価する．
+     *
+     * `compile()` と同じく文の番号を 1 つ進めるので，この文で宣言される大域変数は `g<番号>` になり，
+     * コンパイルされた文からも同じ名前で参照できる．
+     */
+    void Sentence::evaluate(Context &context, JIT &jit){
+        context.next_sentence();
+        std::vector<expression::Evaluated> local_variables(local_count);
+        evaluate_global(context, jit, local_variables);
+    }
+    /**
+     * @brief トップレベルの文を評価する．
+     *
+     * 宣言以外はブロックの中と同じ．
+     */
+    void Sentence::evaluate_global(Context &context, JIT &jit, std::vector<expression::Evaluated> &local_variables){
+        evaluate_local(context, jit, local_variables, true);
+    }
+    void Expression::evaluate_local(Context &context, JIT &jit, std::vector<expression::Evaluated> &local_variables, bool execute){
+        if(expression) expression->evaluate(context, jit, local_variables, execute);
+    }
+    /**
+     * @brief トップレベルの宣言を評価する．
+     *
+     * 大域変数 `g<番号>` を `JIT::define_global()` で確保して初期値を書き込み，`Context::globals` に登録する．
+     */
+    void Declaration::evaluate_global(Context &context, JIT &jit, std::vector<expression::Evaluated> &local_variables){
+        std::optional<expression::Evaluated> initializer;
+        if(expression) initializer = expression->evaluate(context, jit, local_variables, true);
+        auto value_type = declared_type(type, expression, initializer ? initializer->type : nullptr, pos);
+        auto variable_name = context.global_variable_name();
+        jit.define_global(variable_name);
+        if(initializer) jit.store(variable_name, *value_type, initializer->value);
+        context.define_global(
+            binding.index,
+            DeclaredGlobal{context.get_module_number(), std::move(value_type), initializer ? initializer->value : 0, 0, std::nullopt, false}
         );
+        if(superseded) context.retire_global(superseded.value());
+    }
+    //! ブロック中の宣言を評価する．
+    void Declaration::evaluate_local(Context &context, JIT &jit, std::vector<expression::Evaluated> &local_variables, bool execute){
+        std::optional<expression::Evaluated> initializer;
+        if(expression) initializer = expression->evaluate(context, jit, local_variables, execute);
+        auto value_type = declared_type(type, expression, initializer ? initializer->type : nullptr, pos);
+        local_variables[binding.index] = expression::Evaluated{initializer ? initializer->value : 0, std::move(value_type)};
+    }
+    /**
+     * @brief ブロックを評価する．
+     *
+     * 変数は名前解決の番号で直接読み書きするので，外側の変数への代入はそのまま外にも残る．
+     */
+    void Block::evaluate_local(Context &context, JIT &jit, std::vector<expression::Evaluated> &local_variables, bool execute){
+        for(auto &sentence : sentences){
+            sentence->evaluate_local(context, jit, local_variables, execute);
+        }
+    }
+    //! 条件式を評価して，真偽値であることを確かめる
+    static expression::Evaluated evaluate_condition(
+        Context &context,
+        JIT &jit,
+        std::vector<expression::Evaluated> &local_variables,
+        std::unique_ptr<expression::Expression> &condition,
+        bool execute
+    ){
+        auto ret = condition->evaluate(context, jit, local_variables, execute);
+        if(!ret.type->is_boolean()) throw error::make<error::TypeMismatch>(condition->pos.clone());
+        return ret;
+    }
+    /**
+     * @brief if 文を評価する．
+     *
+     * 選ばれなかった節も，型を調べるために `execute = false` で辿る．
+     */
+    void If::evaluate_local(Context &context, JIT &jit, std::vector<expression::Evaluated> &local_variables, bool execute){
+        bool taken = evaluate_condition(context, jit, local_variables, condition, execute).value;
+        if_clause->evaluate_local(context, jit, local_variables, execute && taken);
+        if(else_clause) else_clause->evaluate_local(context, jit, local_variables, execute && !taken);
+    }
+    /**
+     * @brief while 文を評価する．
+     *
+     * 繰り返しは直接評価するとコンパイルするより遅いので，`cost()` は `std::nullopt` を返し，通常はここに来ない．
+     * 一度も繰り返さなくても型を調べられるように，先に `execute = false` で辿る．
+     */
+    void While::evaluate_local(Context &context, JIT &jit, std::vector<expression::Evaluated> &local_variables, bool execute){
+        evaluate_condition(context, jit, local_variables, condition, false);
+        sentence->evaluate_local(context, jit, local_variables, false);
+        if(!execute) return;
+        while(evaluate_condition(context, jit, local_variables, condition, true).value){
+            sentence->evaluate_local(context, jit, local_variables, true);
+        }
     }
-    void Block::compile_global(Context &, std::unordered_map<std::string, value::Value> &){}
-    void If::compile_global(Context &, std::unordered_map<std::string, value::Value> &){}
-    void While::compile_global(Context &, std::unordered_map<std::string, value::Value> &){}
+
+    /**
+     * @brief 文の大きさ（式のノード数の合計）を返す．
+     *
+     * 直接評価するかコンパイルするかの判断に使う．
+     * @retval std::nullopt 繰り返しを含むので，大きさによらずコンパイルしたほうがよい
+     */
+    std::optional<std::size_t> Expression::cost() const {
+        return expression ? 1 + expression->cost() : 1;
+    }
+    std::optional<std::size_t> Declaration::cost() const {
+        return expression ? 1 + expression->cost() : 1;
+    }
+    std::optional<std::size_t> Block::cost() const {
+        std::size_t ret = 1;
+        for(auto &sentence : sentences){
+            auto sentence_cost = sentence->cost();
+            if(!sentence_cost) return std::nullopt;
+            ret += sentence_cost.value();
+        }
+        return ret;
+    }
+    std::optional<std::size_t> If::cost() const {
+        auto if_cost = if_clause->cost();
+        auto else_cost = else_clause ? else_clause->cost() : std::optional<std::size_t>(0);
+        if(!if_cost || !else_cost) return std::nullopt;
+        return 1 + condition->cost() + if_cost.value() + else_cost.value();
+    }
+    std::optional<std::size_t> While::cost() const { return std::nullopt; }
 
     static constexpr std::string_view INDENT = "    ";
+    static std::string_view likelihood_name(Likelihood likelihood){
+        switch(likelihood){
+            case Likelihood::None: return "";
+            case Likelihood::Likely: return " (likely)";
+            case Likelihood::Unlikely: return " (unlikely)";
+        }
+        return "";
+    }
     void Expression::debug_print(int depth) const {
         for(int i = 0; i < depth; ++i) std::cout << INDENT;
         if(expression){
@@ -133,14 +707,14 @@ namespace sentence {
     }
     void If::debug_print(int depth) const {
         for(int i = 0; i < depth; ++i) std::cout << INDENT;
-        std::cout << pos << ": If" << std::endl;
+        std::cout << pos << ": If" << likelihood_name(likelihood) << std::endl;
         condition->debug_print(depth + 1);
         if_clause->debug_print(depth + 1);
         if(else_clause) else_clause->debug_print(depth + 1);
     }
     void While::debug_print(int depth) const {
         for(int i = 0; i < depth; ++i) std::cout << INDENT;
-        std::cout << pos << ": While" << std::endl;
+        std::cout << pos << ": While" << likelihood_name(likelihood) << std::endl;
         condition->debug_print(depth + 1);
         sentence->debug_print(depth + 1);
     }
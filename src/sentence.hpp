@@ -14,21 +14,48 @@
  * <Sentence> ::= <Expression>? `;`
  *              | <Identifier> `:` <Type>? ( `=` <Expression> )? `;`
  *              | `{` <Sentence>* `}`
- *              | `if` `(` <Expression> `)` <Sentence> ( `else` <Sentence> )?
- *              | `while` `(` <Expression> `)` <Sentence>
+ *              | `if` <Likelihood>? `(` <Expression> `)` <Sentence> ( `else` <Sentence> )?
+ *              | `while` <Likelihood>? `(` <Expression> `)` <Sentence>
+ * <Likelihood> ::= `likely` | `unlikely`
  * @endcode
  */
 namespace sentence {
+    /**
+     * @brief `if` `while` の条件に付けるヒント
+     */
+    enum class Likelihood {
+        //! ヒント無し
+        None,
+        //! 条件はほぼ常に真
+        Likely,
+        //! 条件はほぼ常に偽
+        Unlikely
+    };
+
     /**
      * @brief 全ての文の基底クラス．
      */
     class Sentence {
-        virtual void compile_global(Context &, std::unordered_map<std::string, value::Value> &) = 0;
+        virtual void compile_global(Context &, std::vector<expression::Variable> &);
+        //! この文（トップレベル）の中で宣言されるローカル変数の数（`resolve()` で決まる）
+        unsigned local_count = 0;
     public:
         //! ソースコード中の位置．
         pos::Range pos;
         virtual ~Sentence();
-        llvm::orc::ThreadSafeModule compile(Context &);
+        void resolve(Resolver &);
+        virtual void resolve_local(Resolver &) = 0;
+        std::unique_ptr<llvm::Module> compile_module(Context &);
+        static llvm::orc::ThreadSafeModule compile_program(Context &, std::vector<std::unique_ptr<Sentence>> &);
+        virtual void compile_local(Context &, std::vector<expression::Variable> &) = 0;
+        virtual expression::BinaryOperation *simple_assignment();
+        void compile_bytecode(Context &, bytecode::Builder &);
+        virtual void compile_bytecode_global(Context &, bytecode::Builder &, std::vector<expression::Register> &);
+        virtual void compile_bytecode_local(Context &, bytecode::Builder &, std::vector<expression::Register> &) = 0;
+        void evaluate(Context &, JIT &);
+        virtual void evaluate_global(Context &, JIT &, std::vector<expression::Evaluated> &);
+        virtual void evaluate_local(Context &, JIT &, std::vector<expression::Evaluated> &, bool) = 0;
+        virtual std::optional<std::size_t> cost() const = 0;
         //! デバッグ出力用の関数．いずれ消す．
         virtual void debug_print(int = 0) const = 0;
     };
@@ -38,7 +65,12 @@ namespace sentence {
      */
     class Expression : public Sentence {
         std::unique_ptr<expression::Expression> expression;
-        void compile_global(Context &, std::unordered_map<std::string, value::Value> &) override;
+        void resolve_local(Resolver &) override;
+        void compile_local(Context &, std::vector<expression::Variable> &) override;
+        void compile_bytecode_local(Context &, bytecode::Builder &, std::vector<expression::Register> &) override;
+        void evaluate_local(Context &, JIT &, std::vector<expression::Evaluated> &, bool) override;
+        std::optional<std::size_t> cost() const override;
+        expression::BinaryOperation *simple_assignment() override;
         void debug_print(int) const override;
     public:
         Expression(std::unique_ptr<expression::Expression>);
@@ -51,7 +83,18 @@ namespace sentence {
         std::string name;
         std::unique_ptr<type::Type> type;
         std::unique_ptr<expression::Expression> expression;
-        void compile_global(Context &, std::unordered_map<std::string, value::Value> &) override;
+        //! 宣言された変数（`resolve()` で決まる）
+        Binding binding;
+        //! トップレベルで同じ名前の大域変数を宣言し直したなら，隠される前の大域変数の宣言の番号
+        std::optional<unsigned> superseded;
+        void compile_global(Context &, std::vector<expression::Variable> &) override;
+        void resolve_local(Resolver &) override;
+        void compile_local(Context &, std::vector<expression::Variable> &) override;
+        void compile_bytecode_global(Context &, bytecode::Builder &, std::vector<expression::Register> &) override;
+        void evaluate_global(Context &, JIT &, std::vector<expression::Evaluated> &) override;
+        void compile_bytecode_local(Context &, bytecode::Builder &, std::vector<expression::Register> &) override;
+        void evaluate_local(Context &, JIT &, std::vector<expression::Evaluated> &, bool) override;
+        std::optional<std::size_t> cost() const override;
         void debug_print(int) const override;
     public:
         Declaration(std::string, std::unique_ptr<type::Type>, std::unique_ptr<expression::Expression>);
@@ -62,7 +105,14 @@ namespace sentence {
      */
     class Block : public Sentence {
         std::vector<std::unique_ptr<Sentence>> sentences;
-        void compile_global(Context &, std::unordered_map<std::string, value::Value> &) override;
+        //! 中で宣言された名前（出るときに計算済みの式を捨てるため）
+        std::vector<std::string> declared_names;
+        void resolve_local(Resolver &) override;
+        void compile_local(Context &, std::vector<expression::Variable> &) override;
+        void compile_bytecode_local(Context &, bytecode::Builder &, std::vector<expression::Register> &) override;
+        void evaluate_local(Context &, JIT &, std::vector<expression::Evaluated> &, bool) override;
+        std::optional<std::size_t> cost() const override;
+        expression::BinaryOperation *simple_assignment() override;
         void debug_print(int) const override;
     public:
         Block(std::vector<std::unique_ptr<Sentence>>);
@@ -73,11 +123,16 @@ namespace sentence {
      */
     class If : public Sentence {
         std::unique_ptr<expression::Expression> condition;
+        Likelihood likelihood;
         std::unique_ptr<Sentence> if_clause, else_clause;
-        void compile_global(Context &, std::unordered_map<std::string, value::Value> &) override;
+        void resolve_local(Resolver &) override;
+        void compile_local(Context &, std::vector<expression::Variable> &) override;
+        void compile_bytecode_local(Context &, bytecode::Builder &, std::vector<expression::Register> &) override;
+        void evaluate_local(Context &, JIT &, std::vector<expression::Evaluated> &, bool) override;
+        std::optional<std::size_t> cost() const override;
         void debug_print(int) const override;
     public:
-        If(std::unique_ptr<expression::Expression>, std::unique_ptr<Sentence>, std::unique_ptr<Sentence>);
+        If(std::unique_ptr<expression::Expression>, Likelihood, std::unique_ptr<Sentence>, std::unique_ptr<Sentence>);
     };
 
     /**
@@ -85,11 +140,16 @@ namespace sentence {
      */
     class While : public Sentence {
         std::unique_ptr<expression::Expression> condition;
+        Likelihood likelihood;
         std::unique_ptr<Sentence> sentence;
-        void compile_global(Context &, std::unordered_map<std::string, value::Value> &) override;
+        void resolve_local(Resolver &) override;
+        void compile_local(Context &, std::vector<expression::Variable> &) override;
+        void compile_bytecode_local(Context &, bytecode::Builder &, std::vector<expression::Register> &) override;
+        void evaluate_local(Context &, JIT &, std::vector<expression::Evaluated> &, bool) override;
+        std::optional<std::size_t> cost() const override;
         void debug_print(int) const override;
     public:
-        While(std::unique_ptr<expression::Expression>, std::unique_ptr<Sentence>);
+        While(std::unique_ptr<expression::Expression>, Likelihood, std::unique_ptr<Sentence>);
     };
 }
 
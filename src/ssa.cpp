@@ -0,0 +1,122 @@
+/**
+ * @file ssa.cpp
+ */
+#include "ssa.hpp"
+
+#include "llvm/IR/CFG.h"
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/IRBuilder.h"
+
+namespace ssa {
+    //! 新しい関数のために，すべての変数とブロックの情報を捨てる．
+    void Builder::clear(){
+        variables.clear();
+        definitions.clear();
+        incomplete_phis.clear();
+        sealed_blocks.clear();
+    }
+
+    /**
+     * @brief 新しい変数を作る．
+     * @param type 変数の型
+     * @param name `phi` の名前に使う
+     * @return 変数の番号
+     */
+    unsigned Builder::new_variable(llvm::Type *type, std::string name){
+        variables.emplace_back(type, std::move(name));
+        definitions.emplace_back();
+        return static_cast<unsigned>(variables.size() - 1);
+    }
+
+    //! ブロック `block` で変数 `variable` に `value` を代入する．
+    void Builder::write(unsigned variable, llvm::BasicBlock *block, llvm::Value *value){
+        definitions[variable][block] = value;
+    }
+
+    //! ブロック `block` の現在の位置での変数 `variable` の値を返す．
+    llvm::Value *Builder::read(unsigned variable, llvm::BasicBlock *block){
+        auto definition = definitions[variable].find(block);
+        if(definition != definitions[variable].end()) return definition->second;
+        return read_recursive(variable, block);
+    }
+
+    /**
+     * @brief ブロック `block` 内に定義が無い変数を先行ブロックから探す．
+     *
+     * - 封印されていなければ不完全な `phi` を置く．
+     * - 先行ブロックが 1 つならそこから読む．
+     * - そうでなければ `phi` を置いてから（ループで自分自身に戻ってくるため）各先行ブロックから読む．
+     */
+    llvm::Value *Builder::read_recursive(unsigned variable, llvm::BasicBlock *block){
+        auto &[type, name] = variables[variable];
+        llvm::Value *ret;
+        if(!sealed_blocks.contains(block)){
+            auto phi = llvm::IRBuilder<>(block, block->begin()).CreatePHI(type, 2, name);
+            incomplete_phis[block].emplace_back(variable, phi);
+            ret = phi;
+        }else if(auto predecessor = block->getSinglePredecessor()){
+            ret = read(variable, predecessor);
+        }else if(llvm::pred_empty(block)){
+            // 関数の入口で代入されていない変数（宣言は必ず初期化するので通常は起こらない）
+            ret = llvm::UndefValue::get(type);
+        }else{
+            auto phi = llvm::IRBuilder<>(block, block->begin()).CreatePHI(type, 2, name);
+            write(variable, block, phi);
+            ret = add_phi_operands(variable, phi);
+        }
+        write(variable, block, ret);
+        return ret;
+    }
+
+    //! `phi` の各先行ブロックでの変数の値をオペランドにする．
+    llvm::Value *Builder::add_phi_operands(unsigned variable, llvm::PHINode *phi){
+        for(auto predecessor : llvm::predecessors(phi->getParent())){
+            phi->addIncoming(read(variable, predecessor), predecessor);
+        }
+        return try_remove_trivial_phi(phi);
+    }
+
+    /**
+     * @brief オペランドが自分自身以外に 1 種類しか無い `phi` を，その値で置き換えて取り除く．
+     *
+     * 取り除いた `phi` を使っていた `phi` も自明になっているかもしれないので，再帰的に調べる．
+     * @return `phi` を取り除いたなら置き換えた値，そうでなければ `phi`
+     */
+    llvm::Value *Builder::try_remove_trivial_phi(llvm::PHINode *phi){
+        llvm::Value *same = nullptr;
+        for(llvm::Value *operand : phi->incoming_values()){
+            if(operand == same || operand == phi) continue;
+            if(same) return phi;
+            same = operand;
+        }
+        if(!same) same = llvm::UndefValue::get(phi->getType());
+        // 再帰の途中で取り除かれる `phi` もあるので，`llvm::WeakTrackingVH` で追う
+        llvm::SmallVector<llvm::WeakTrackingVH, 4> users;
+        for(auto user : phi->users()){
+            if(user != phi && llvm::isa<llvm::PHINode>(user)) users.emplace_back(user);
+        }
+        // `definitions` の `llvm::WeakTrackingVH` もここで `same` に置き換わる
+        phi->replaceAllUsesWith(same);
+        phi->eraseFromParent();
+        llvm::WeakTrackingVH ret(same);
+        for(auto &user : users){
+            if(auto user_phi = llvm::dyn_cast_or_null<llvm::PHINode>(user)) try_remove_trivial_phi(user_phi);
+        }
+        return ret;
+    }
+
+    /**
+     * @brief ブロック `block` の先行ブロックがすべて揃ったことを知らせる．
+     *
+     * 置いておいた不完全な `phi` にオペランドを埋める．
+     */
+    void Builder::seal(llvm::BasicBlock *block){
+        auto incomplete = incomplete_phis.find(block);
+        if(incomplete != incomplete_phis.end()){
+            auto phis = std::move(incomplete->second);
+            incomplete_phis.erase(incomplete);
+            for(auto [variable, phi] : phis) add_phi_operands(variable, phi);
+        }
+        sealed_blocks.insert(block);
+    }
+}
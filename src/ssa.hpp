@@ -0,0 +1,52 @@
+/**
+ * @file ssa.hpp
+ * @brief ローカル変数を SSA 形式で直接構築する
+ */
+#ifndef SSA_HPP
+#define SSA_HPP
+
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/SmallPtrSet.h"
+#include "llvm/IR/BasicBlock.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/ValueHandle.h"
+
+/**
+ * @brief ローカル変数を `alloca` を経由せずに SSA 形式で直接構築する．
+ *
+ * Braun et al., "Simple and Efficient Construction of Static Single Assignment Form" (CC 2013) の方法．
+ * 変数の定義を基本ブロックごとに記録し，読むときに必要な `phi` だけをその場で作る．
+ * 先行ブロックがすべて決まっていない（封印されていない）ブロックでは `phi` を不完全なまま置いておき，
+ * `seal()` で先行ブロックが確定したときにオペランドを埋める．
+ * オペランドがすべて同じ値になった `phi` はその場で取り除く．
+ */
+namespace ssa {
+    /**
+     * @brief 1 つの関数についてローカル変数の SSA 形式を構築するクラス．
+     */
+    class Builder {
+        //! 変数ごとの型と名前
+        std::vector<std::pair<llvm::Type *, std::string>> variables;
+        //! 変数ごとの，基本ブロックの最後での値（`phi` が取り除かれたら置き換え後の値を指す）
+        std::vector<llvm::DenseMap<llvm::BasicBlock *, llvm::WeakTrackingVH>> definitions;
+        //! 封印されていないブロックに置いた，オペランドの無い `phi`
+        std::unordered_map<llvm::BasicBlock *, std::vector<std::pair<unsigned, llvm::PHINode *>>> incomplete_phis;
+        llvm::SmallPtrSet<llvm::BasicBlock *, 16> sealed_blocks;
+        llvm::Value *read_recursive(unsigned, llvm::BasicBlock *);
+        llvm::Value *add_phi_operands(unsigned, llvm::PHINode *);
+        llvm::Value *try_remove_trivial_phi(llvm::PHINode *);
+    public:
+        void clear();
+        unsigned new_variable(llvm::Type *, std::string);
+        void write(unsigned, llvm::BasicBlock *, llvm::Value *);
+        llvm::Value *read(unsigned, llvm::BasicBlock *);
+        void seal(llvm::BasicBlock *);
+    };
+}
+
+#endif
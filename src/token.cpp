@@ -23,6 +23,8 @@ namespace token {
         if(name == "if") return Keyword::If;
         if(name == "else") return Keyword::Else;
         if(name == "while") return Keyword::While;
+        if(name == "likely") return Keyword::Likely;
+        if(name == "unlikely") return Keyword::Unlikely;
         return std::nullopt;
     }
 
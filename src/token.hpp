@@ -17,7 +17,11 @@ namespace token {
         //! `else` 条件分岐
         Else,
         //! `while` ループ
-        While
+        While,
+        //! `likely` 条件がほぼ常に真であるというヒント
+        Likely,
+        //! `unlikely` 条件がほぼ常に偽であるというヒント
+        Unlikely
     };
 
     /**
@@ -0,0 +1,65 @@
+/**
+ * @file trace.cpp
+ */
+#include "trace.hpp"
+
+#include <sstream>
+
+#include "llvm/Support/Error.h"
+#include "llvm/Support/raw_ostream.h"
+
+namespace trace {
+    /**
+     * @brief これより短い区間は記録しない（マイクロ秒）
+     *
+     * 文ごとの区間は短いので，すべて記録する．
+     */
+    static constexpr unsigned GRANULARITY = 0;
+
+    //! 記録を始める．
+    void start(){
+        llvm::timeTraceProfilerInitialize(GRANULARITY, "interpreter");
+    }
+
+    /**
+     * @brief 記録を `path` に書き出して終える．
+     * @retval false 書き出せなかった（理由を標準エラー出力に出力済み）
+     */
+    bool finish(const std::string &path){
+        auto error = llvm::timeTraceProfilerWrite(path, "");
+        llvm::timeTraceProfilerCleanup();
+        if(!error) return true;
+        llvm::logAllUnhandledErrors(std::move(error), llvm::errs(), "cannot write the time trace: ");
+        return false;
+    }
+
+    //! 区間の詳細にする文の位置
+    std::string describe(const pos::Range &range){
+        std::ostringstream ret;
+        ret << range;
+        return ret.str();
+    }
+
+    /**
+     * @brief 区間の詳細にするモジュールの統計
+     *
+     * モジュール名と，定義された関数・大域変数・命令の数．
+     */
+    std::string describe(const llvm::Module &module){
+        std::size_t functions = 0, globals = 0;
+        for(auto &function : module.functions()){
+            if(!function.isDeclaration()) functions++;
+        }
+        for(auto &global : module.globals()){
+            if(!global.isDeclaration()) globals++;
+        }
+        std::string ret;
+        llvm::raw_string_ostream stream(ret);
+        stream
+            << module.getName() << ": "
+            << functions << " functions, "
+            << globals << " globals, "
+            << module.getInstructionCount() << " instructions";
+        return stream.str();
+    }
+}
@@ -0,0 +1,32 @@
+/**
+ * @file trace.hpp
+ * @brief 各段階にかかった時間を記録する
+ */
+#ifndef TRACE_HPP
+#define TRACE_HPP
+
+#include <string>
+
+#include "pos.hpp"
+
+#include "llvm/IR/Module.h"
+#include "llvm/Support/TimeProfiler.h"
+
+/**
+ * @brief `--time-trace` で各段階にかかった時間を記録する．
+ *
+ * 記録には `llvm::TimeTraceScope` を使う．区間はスコープの入れ子の通りに入れ子になり，
+ * LLVM のパスもそれぞれ区間として記録される（`llvm::PassManager`）．
+ * `start()` していなければ，区間の開始と終了は分岐 1 つだけで何もしない．
+ * 区間の詳細の文字列は関数で渡し，記録するときだけ作る．
+ *
+ * 出力は Chrome の trace event 形式の JSON で，Perfetto や `chrome://tracing` で読み込める．
+ */
+namespace trace {
+    void start();
+    bool finish(const std::string &);
+    std::string describe(const pos::Range &);
+    std::string describe(const llvm::Module &);
+}
+
+#endif
@@ -20,6 +20,12 @@ namespace value {
     llvm::Constant *Boolean::default_value(llvm::LLVMContext &context){
         return llvm::ConstantInt::getFalse(context);
     }
+    //! 整数型か
+    bool Type::is_integer() const { return false; }
+    bool Integer::is_integer() const { return true; }
+    //! 真偽値型か
+    bool Type::is_boolean() const { return false; }
+    bool Boolean::is_boolean() const { return true; }
     Value::Value(): llvm_value(nullptr) {}
     Value::Value(std::shared_ptr<value::Type> type, llvm::Value *llvm_value): type(std::move(type)), llvm_value(llvm_value) {}
 }
@@ -25,6 +25,7 @@ namespace value {
         virtual ~Type();
         virtual llvm::Type *llvm_type(llvm::LLVMContext &) = 0;
         virtual llvm::Constant *default_value(llvm::LLVMContext &) = 0;
+        virtual bool is_integer() const, is_boolean() const;
     };
 
     /**
@@ -49,11 +50,13 @@ namespace value {
     class Integer : public Type {
         llvm::Type *llvm_type(llvm::LLVMContext &) override;
         llvm::Constant *default_value(llvm::LLVMContext &) override;
+        bool is_integer() const override;
     };
 
     class Boolean : public Type {
         llvm::Type *llvm_type(llvm::LLVMContext &) override;
         llvm::Constant *default_value(llvm::LLVMContext &) override;
+        bool is_boolean() const override;
     };
 
     // class Function : public Type {
@@ -0,0 +1,102 @@
+/**
+ * @file vm.cpp
+ */
+#include "vm.hpp"
+
+/**
+ * @brief `code` を実行する．
+ *
+ * GNU 拡張の computed goto（`&&label`，`goto *`）で命令をディスパッチする．
+ * `labels` の並びは `bytecode::Opcode` の定義順と一致させること．
+ * 演算の意味は `bytecode::apply()` に従う（オペコードが定数なのでインライン展開される）．
+ * 0 による除算は，その命令を生成した式の位置（`bytecode::Code::position()`）で報告する．
+ * 位置は除数が 0 のときだけ引く．
+ * @throw error::DivisionByZero 0 で割った（それまでに書き込んだ大域変数の値は残る）
+ */
+void VM::run(const bytecode::Code &code){
+    using bytecode::Opcode;
+    static void *const labels[] = {
+        &&op_constant,
+        &&op_move,
+        &&op_load_global,
+        &&op_store_global,
+        &&op_add,
+        &&op_sub,
+        &&op_mul,
+        &&op_div,
+        &&op_rem,
+        &&op_left_shift,
+        &&op_right_shift,
+        &&op_bit_and,
+        &&op_bit_or,
+        &&op_bit_xor,
+        &&op_minus,
+        &&op_bit_not,
+        &&op_logical_not,
+        &&op_equal,
+        &&op_not_equal,
+        &&op_less,
+        &&op_less_equal,
+        &&op_greater,
+        &&op_greater_equal,
+        &&op_jump,
+        &&op_jump_if,
+        &&op_jump_unless,
+        &&op_jump_unless_equal,
+        &&op_jump_unless_not_equal,
+        &&op_jump_unless_less,
+        &&op_jump_unless_less_equal,
+        &&op_jump_unless_greater,
+        &&op_jump_unless_greater_equal,
+        &&op_add_global,
+        &&op_return
+    };
+    static_assert(sizeof(labels) / sizeof(labels[0]) == static_cast<std::size_t>(Opcode::Return) + 1);
+
+    if(globals.size() < code.global_count) globals.resize(code.global_count);
+    registers.assign(code.register_count, 0);
+    std::int32_t *r = registers.data(), *g = globals.data();
+    const bytecode::Instruction *begin = code.instructions.data(), *pc = begin;
+
+#define DISPATCH() goto *labels[static_cast<std::size_t>(pc->opcode)]
+#define NEXT() do{ ++pc; DISPATCH(); }while(false)
+#define JUMP(target) do{ pc = begin + (target); DISPATCH(); }while(false)
+    DISPATCH();
+op_constant: r[pc->a] = pc->b; NEXT();
+op_move: r[pc->a] = r[pc->b]; NEXT();
+op_load_global: r[pc->a] = g[pc->b]; NEXT();
+op_store_global: g[pc->a] = r[pc->b]; NEXT();
+op_add: r[pc->a] = bytecode::apply(Opcode::Add, r[pc->b], r[pc->c]); NEXT();
+op_sub: r[pc->a] = bytecode::apply(Opcode::Sub, r[pc->b], r[pc->c]); NEXT();
+op_mul: r[pc->a] = bytecode::apply(Opcode::Mul, r[pc->b], r[pc->c]); NEXT();
+op_div: r[pc->a] = bytecode::apply(Opcode::Div, r[pc->b], r[pc->c], r[pc->c] ? nullptr : code.position(static_cast<std::size_t>(pc - begin))); NEXT();
+op_rem: r[pc->a] = bytecode::apply(Opcode::Rem, r[pc->b], r[pc->c], r[pc->c] ? nullptr : code.position(static_cast<std::size_t>(pc - begin))); NEXT();
+op_left_shift: r[pc->a] = bytecode::apply(Opcode::LeftShift, r[pc->b], r[pc->c]); NEXT();
+op_right_shift: r[pc->a] = bytecode::apply(Opcode::RightShift, r[pc->b], r[pc->c]); NEXT();
+op_bit_and: r[pc->a] = bytecode::apply(Opcode::BitAnd, r[pc->b], r[pc->c]); NEXT();
+op_bit_or: r[pc->a] = bytecode::apply(Opcode::BitOr, r[pc->b], r[pc->c]); NEXT();
+op_bit_xor: r[pc->a] = bytecode::apply(Opcode::BitXor, r[pc->b], r[pc->c]); NEXT();
+op_minus: r[pc->a] = bytecode::apply(Opcode::Minus, r[pc->b], 0); NEXT();
+op_bit_not: r[pc->a] = bytecode::apply(Opcode::BitNot, r[pc->b], 0); NEXT();
+op_logical_not: r[pc->a] = bytecode::apply(Opcode::LogicalNot, r[pc->b], 0); NEXT();
+op_equal: r[pc->a] = bytecode::apply(Opcode::Equal, r[pc->b], r[pc->c]); NEXT();
+op_not_equal: r[pc->a] = bytecode::apply(Opcode::NotEqual, r[pc->b], r[pc->c]); NEXT();
+op_less: r[pc->a] = bytecode::apply(Opcode::Less, r[pc->b], r[pc->c]); NEXT();
+op_less_equal: r[pc->a] = bytecode::apply(Opcode::LessEqual, r[pc->b], r[pc->c]); NEXT();
+op_greater: r[pc->a] = bytecode::apply(Opcode::Greater, r[pc->b], r[pc->c]); NEXT();
+op_greater_equal: r[pc->a] = bytecode::apply(Opcode::GreaterEqual, r[pc->b], r[pc->c]); NEXT();
+op_jump: JUMP(pc->a);
+op_jump_if: if(r[pc->a]) JUMP(pc->b); NEXT();
+op_jump_unless: if(!r[pc->a]) JUMP(pc->b); NEXT();
+op_jump_unless_equal: if(!(r[pc->a] == r[pc->b])) JUMP(pc->c); NEXT();
+op_jump_unless_not_equal: if(!(r[pc->a] != r[pc->b])) JUMP(pc->c); NEXT();
+op_jump_unless_less: if(!(r[pc->a] < r[pc->b])) JUMP(pc->c); NEXT();
+op_jump_unless_less_equal: if(!(r[pc->a] <= r[pc->b])) JUMP(pc->c); NEXT();
+op_jump_unless_greater: if(!(r[pc->a] > r[pc->b])) JUMP(pc->c); NEXT();
+op_jump_unless_greater_equal: if(!(r[pc->a] >= r[pc->b])) JUMP(pc->c); NEXT();
+op_add_global: r[pc->a] = g[pc->b] = bytecode::apply(Opcode::Add, g[pc->b], r[pc->c]); NEXT();
+op_return: return;
+#undef JUMP
+#undef NEXT
+#undef DISPATCH
+}
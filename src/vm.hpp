@@ -0,0 +1,22 @@
+/**
+ * @file vm.hpp
+ * @brief バイトコードを実行する仮想機械
+ */
+#ifndef VM_HPP
+#define VM_HPP
+
+#include "bytecode.hpp"
+
+/**
+ * @brief `bytecode::Code` を実行する仮想機械．
+ *
+ * 大域変数は `VM` が持ち続けるので，文ごとに `run()` を呼び出しても値が引き継がれる．
+ */
+class VM {
+    std::vector<std::int32_t> globals;
+    std::vector<std::int32_t> registers;
+public:
+    void run(const bytecode::Code &);
+};
+
+#endif